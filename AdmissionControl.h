@@ -0,0 +1,143 @@
+#ifndef ADMISSION_CONTROL_H
+#define ADMISSION_CONTROL_H
+
+#include <atomic>
+#include <cstdint>
+#include <algorithm>
+#include "process.h"
+
+// Memory-aware dispatch. A process with memory may only run while admitted,
+// with its working set (see WorkingSet.h) charged against a budget of page
+// frames; a process that does not fit is deferred until there is room. This
+// keeps the processes taking turns on the cores from evicting each other's
+// pages every quantum.
+//
+// The budget starts at the frame count and follows the page fault frequency
+// of admitted processes once their working set is loaded (faults per 1000
+// instructions over the last ADJUST_TURNS turns, not counting the first
+// `window` turns after admission): above the target it shrinks by an
+// eighth, below half the target it grows back.
+//
+// The first process turned away reserves its share: others are only
+// admitted next to it if it still fits, and admitted processes make room by
+// giving up their charge after RESIDENT_WINDOWS windows of turns, so a
+// large working set gets in eventually; the scheduler tries it first when
+// it looks for deferred processes that fit. While the admitted set is over
+// budget, its processes leave it after one window. Nothing admitted means
+// anyone fits, reservation or not, so dispatch never stalls. A process's ws_charged and
+// admitted_turns belong to whoever holds it.
+class AdmissionControl {
+public:
+    struct Stats {
+        uint32_t frames;
+        uint32_t budget;
+        int64_t admitted;     // pages charged
+        uint64_t deferrals;
+        uint64_t pff;         // faults per 1000 instructions, last window
+    };
+
+    // window: turns of working set history (0 disables); frames: 0 if
+    // there is no memory manager
+    AdmissionControl(unsigned window, uint32_t pff_target, uint32_t frames)
+        : window(window), pff_target(pff_target), frames(frames), budget(frames) {}
+
+    bool enabled() const { return window > 0 && frames > 0; }
+
+    // Charge p's working set (one page until it is known) if it fits, as
+    // anything does while nothing is admitted. False: defer p.
+    bool admit(ProcessStub &p) {
+        if (!enabled() || p.num_pages == 0 || p.ws_charged) return true;
+        uint32_t need = p.working_set.size() ? (uint32_t)p.working_set.size() : 1u;
+        int reserver = reserved_by.load();
+        int64_t held = reserver >= 0 && reserver != p.id ? reserved.load() : 0;
+        int64_t cur = admitted.load();
+        do {
+            if (cur > 0 && cur + need + held > (int64_t)budget.load()) {
+                deferrals.fetch_add(1, std::memory_order_relaxed);
+                if (reserver < 0 && reserved_by.compare_exchange_strong(reserver, p.id)) reserved.store(need);
+                return false;
+            }
+        } while (!admitted.compare_exchange_weak(cur, cur + need));
+        p.ws_charged = need;
+        p.admitted_turns = 0;
+        if (reserver == p.id) unreserve(p);
+        return true;
+    }
+
+    // p's turn is over: refresh its working set and charge, and feed its
+    // faults and instructions into the fault frequency
+    void end_turn(ProcessStub &p, uint64_t faults, uint64_t instructions) {
+        if (!enabled() || p.num_pages == 0) return;
+        uint32_t ws = (uint32_t)std::max<size_t>(1, p.working_set.end_turn(window));
+        if (!p.ws_charged) return;
+        admitted.fetch_add((int64_t)ws - p.ws_charged);
+        p.ws_charged = ws;
+        // the first window after admission loads the working set; only
+        // faults after that say the admitted set does not fit
+        if (++p.admitted_turns <= window) return;
+        window_faults.fetch_add(faults, std::memory_order_relaxed);
+        window_instructions.fetch_add(instructions, std::memory_order_relaxed);
+        if (turns.fetch_add(1) % ADJUST_TURNS == ADJUST_TURNS - 1) adjust();
+    }
+
+    // An admitted p that has had its turns while another waits, or one of
+    // the admitted set grown past the budget (working sets grew, or the
+    // budget shrank)
+    bool should_yield(const ProcessStub &p) const {
+        if (!p.ws_charged) return false;
+        if (p.admitted_turns >= window && admitted.load() > (int64_t)budget.load()) return true;
+        return p.admitted_turns >= window * RESIDENT_WINDOWS && reserved_by.load() >= 0;
+    }
+
+    // Id of the process holding the reservation, -1 if none
+    int reserver() const { return reserved_by.load(); }
+
+    // p leaves the admitted set (finished, asleep or yielding)
+    void release(ProcessStub &p) {
+        if (p.ws_charged) admitted.fetch_sub(p.ws_charged);
+        p.ws_charged = 0;
+        p.admitted_turns = 0;
+        unreserve(p);
+    }
+
+    Stats stats() const {
+        return Stats{frames, budget.load(), admitted.load(), deferrals.load(), last_pff.load()};
+    }
+
+private:
+    static constexpr uint64_t ADJUST_TURNS = 32;
+    static constexpr unsigned RESIDENT_WINDOWS = 4;   // admitted turns before yielding, in windows
+
+    void unreserve(const ProcessStub &p) {
+        int id = p.id;
+        if (reserved_by.compare_exchange_strong(id, -1)) reserved.store(0);
+    }
+
+    void adjust() {
+        uint64_t faults = window_faults.exchange(0);
+        uint64_t n = window_instructions.exchange(0);
+        if (n == 0) return;
+        uint64_t pff = faults * 1000 / n;
+        last_pff.store(pff);
+        uint32_t b = budget.load();
+        uint32_t floor = std::max<uint32_t>(1, frames / 4);
+        if (pff > pff_target) b = std::max(floor, b - b / 8);
+        else if (pff < pff_target / 2) b = std::min(frames, b + std::max<uint32_t>(1, frames / 16));
+        budget.store(b);
+    }
+
+    const unsigned window;
+    const uint64_t pff_target;
+    const uint32_t frames;
+    std::atomic<uint32_t> budget;
+    std::atomic<int64_t> admitted{0};
+    std::atomic<int> reserved_by{-1};     // process id, -1 = none
+    std::atomic<int64_t> reserved{0};
+    std::atomic<uint64_t> deferrals{0};
+    std::atomic<uint64_t> window_faults{0};
+    std::atomic<uint64_t> window_instructions{0};
+    std::atomic<uint64_t> turns{0};
+    std::atomic<uint64_t> last_pff{0};
+};
+
+#endif
@@ -0,0 +1,294 @@
+#ifndef BYTECODE_H
+#define BYTECODE_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <cstdint>
+#include <algorithm>
+#include <climits>
+
+// Process instructions are compiled once from CustomProcessLines::lines so
+// the core loop never re-tokenizes text. Operands are parsed up front:
+// immediates and addresses become numbers, variable names become indices
+// into Program::var_names, already bound to the process's symbol table.
+// Strings are kept only where logs need them.
+
+// Symbol table of a process: up to 32 uint16 variables. Variable slot i is
+// stored at virtual address 2 * i, in the 64-byte symbol table segment at
+// the start of the process's memory. Names get a slot on first use and keep
+// it; once all slots are taken, further variables are ignored.
+struct SymbolTable {
+    static constexpr int SLOTS = 32;
+    static constexpr uint32_t SEGMENT_BYTES = SLOTS * sizeof(uint16_t);
+
+    std::vector<std::string> names;   // slot -> name
+
+    int find(const std::string &name) const {
+        for (size_t i = 0; i < names.size(); ++i)
+            if (names[i] == name) return (int)i;
+        return -1;
+    }
+
+    // Slot for name, adding it if there is room; -1 if the table is full
+    int bind(const std::string &name) {
+        int s = find(name);
+        if (s != -1 || names.size() >= (size_t)SLOTS) return s;
+        names.push_back(name);
+        return (int)names.size() - 1;
+    }
+};
+
+// FOR n ... END repeats the lines in between n times; loops nest up to
+// this many levels
+constexpr int FOR_MAX_DEPTH = 3;
+
+enum class Opcode : uint8_t {
+    NOP,        // blank line
+    DECLARE,    // arg0: variable, arg1: value
+    SKIP,       // not executed by the scheduler; text: the opcode
+    BAD,        // malformed or invalid operands; text: the log message
+    PRINT,      // text: message
+    SLEEP,      // arg0: ms
+    ADD, SUB,   // arg0: target variable, arg1/arg2: operands
+    FOR,        // arg0: count, arg1: index of the matching END (own index if none)
+    END,        // arg0: index of the matching FOR
+    READ,       // arg0: target variable, arg1: address; text: address as written
+    WRITE,      // arg0: address, arg1: value; text: address
+    COPY,       // arg0: dst, arg1: src, arg2: len; text: dst, text + 1: src
+    FILL,       // arg0: address, arg1: byte, arg2: len; text: address
+};
+
+struct Instr {
+    Opcode op = Opcode::NOP;
+    uint8_t var_mask = 0;   // bit i set: arg[i] is a variable, else an immediate
+    uint32_t text = 0;      // index into Program::strings
+    uint32_t arg[3] = {};
+
+    bool is_var(int i) const { return var_mask & (1u << i); }
+};
+
+struct Program {
+    std::vector<Instr> code;
+    int executed_total = 0;               // instructions run in total, counting loop iterations
+    std::vector<std::string> var_names;   // variable -> name
+    std::vector<int> var_slots;           // variable -> symbol table slot, -1 if it did not fit
+    std::vector<std::string> strings;
+};
+
+// Single-pass compiler; binds each variable name to a symbol slot on first use
+class ProgramCompiler {
+public:
+    ProgramCompiler(Program &p, SymbolTable &syms) : prog(p), symbols(syms) {}
+
+    // Compiles one line; it becomes instruction prog.code.size()
+    Instr compile(const std::string &instr);
+
+    // Closes loops left open (they get an empty body) and counts executions
+    void finish();
+
+private:
+    Program &prog;
+    SymbolTable &symbols;
+    std::map<std::string, uint32_t> vars;
+    std::vector<int> open_loops;   // indices of FORs awaiting their END (-1: rejected FOR)
+
+    uint32_t var(const std::string &name) {
+        auto it = vars.find(name);
+        if (it != vars.end()) return it->second;
+        uint32_t v = (uint32_t)prog.var_names.size();
+        prog.var_names.push_back(name);
+        prog.var_slots.push_back(symbols.bind(name));
+        vars.emplace(name, v);
+        return v;
+    }
+
+    uint32_t text(const std::string &s) {
+        prog.strings.push_back(s);
+        return (uint32_t)prog.strings.size() - 1;
+    }
+
+    Instr bad(const std::string &msg) {
+        Instr ins;
+        ins.op = Opcode::BAD;
+        ins.text = text(msg);
+        return ins;
+    }
+
+    // A token that parses as an integer is a literal clamped to uint16,
+    // anything else names a variable
+    void operand(Instr &ins, int i, const std::string &tok) {
+        try {
+            int v = std::stoi(tok);
+            ins.arg[i] = (uint32_t)std::max(0, std::min(65535, v));
+        } catch (...) {
+            ins.arg[i] = var(tok);
+            ins.var_mask |= (uint8_t)(1u << i);
+        }
+    }
+};
+
+inline Instr ProgramCompiler::compile(const std::string &instr) {
+    Instr ins;
+    size_t s = instr.find_first_not_of(" \t\r\n");
+    if (s == std::string::npos) return ins;
+
+    std::istringstream iss(instr.substr(s));
+    std::string op;
+    iss >> op;
+    if (op == "DECLARE") {
+        std::string name, val;
+        iss >> name >> val;
+        if (name.empty() || val.empty()) return bad("Malformed DECLARE instruction");
+        ins.op = Opcode::DECLARE;
+        ins.arg[0] = var(name);
+        ins.var_mask = 1;
+        operand(ins, 1, val);
+    } else if (op == "SLEEP") {
+        std::string tstr; iss >> tstr;
+        int t = 50;
+        try { t = std::stoi(tstr); } catch(...) {}
+        ins.op = Opcode::SLEEP;
+        ins.arg[0] = (uint32_t)t;
+    } else if (op == "PRINT") {
+        // rest of line is message (may be quoted)
+        std::string rest;
+        std::getline(iss, rest);
+        if (!rest.empty()) {
+            size_t ppos = rest.find_first_not_of(" \t\r\n\"");
+            if (ppos != std::string::npos) rest = rest.substr(ppos);
+            size_t epos = rest.find_last_not_of(" \t\r\n\"");
+            if (epos != std::string::npos) rest = rest.substr(0, epos + 1);
+        }
+        ins.op = Opcode::PRINT;
+        ins.text = text(rest);
+    } else if (op == "ADD" || op == "SUB") {
+        std::string target, a, b;
+        iss >> target >> a >> b;
+        if (target.empty() || a.empty() || b.empty()) return bad("Malformed " + op + " instruction");
+        ins.op = op == "ADD" ? Opcode::ADD : Opcode::SUB;
+        ins.arg[0] = var(target);
+        ins.var_mask = 1;
+        operand(ins, 1, a);
+        operand(ins, 2, b);
+    } else if (op == "FOR") {
+        std::string nstr; iss >> nstr;
+        int n = 1;
+        try { n = std::stoi(nstr); } catch(...) {}
+        if (open_loops.size() >= (size_t)FOR_MAX_DEPTH) {
+            // body runs once, inline; its END is dropped
+            open_loops.push_back(-1);
+            return bad("FOR nested deeper than " + std::to_string(FOR_MAX_DEPTH) + " levels");
+        }
+        uint32_t self = (uint32_t)prog.code.size();
+        open_loops.push_back((int)self);
+        ins.op = Opcode::FOR;
+        ins.arg[0] = (uint32_t)n;
+        ins.arg[1] = self;
+    } else if (op == "END") {
+        if (open_loops.empty()) return bad("END without FOR");
+        int f = open_loops.back();
+        open_loops.pop_back();
+        if (f < 0) return ins;
+        prog.code[f].arg[1] = (uint32_t)prog.code.size();
+        ins.op = Opcode::END;
+        ins.arg[0] = (uint32_t)f;
+    } else if (op == "READ") {
+        std::string name, addrstr;
+        iss >> name >> addrstr;
+        if (name.empty() || addrstr.empty()) return bad("Malformed READ instruction");
+        try { ins.arg[1] = (uint32_t)std::stoul(addrstr, nullptr, 0); } catch(...) {
+            return bad("Invalid READ address: " + addrstr);
+        }
+        ins.op = Opcode::READ;
+        ins.arg[0] = var(name);
+        ins.var_mask = 1;
+        ins.text = text(addrstr);
+    } else if (op == "WRITE") {
+        std::string addrstr, valstr;
+        iss >> addrstr >> valstr;
+        if (addrstr.empty() || valstr.empty()) return bad("Malformed WRITE instruction");
+        try { ins.arg[0] = (uint32_t)std::stoul(addrstr, nullptr, 0); } catch(...) {
+            return bad("Invalid WRITE address: " + addrstr);
+        }
+        int v = 0;
+        try { v = std::stoi(valstr); } catch(...) {
+            return bad("Invalid WRITE value: " + valstr);
+        }
+        ins.op = Opcode::WRITE;
+        ins.arg[1] = (uint32_t)std::max(0, std::min(65535, v));
+        ins.text = text(addrstr);
+    } else if (op == "COPY") {
+        // COPY <dst> <src> <len>: block copy of len bytes (ranges may overlap)
+        std::string dststr, srcstr, lenstr;
+        iss >> dststr >> srcstr >> lenstr;
+        if (dststr.empty() || srcstr.empty() || lenstr.empty()) return bad("Malformed COPY instruction");
+        try {
+            ins.arg[0] = (uint32_t)std::stoul(dststr, nullptr, 0);
+            ins.arg[1] = (uint32_t)std::stoul(srcstr, nullptr, 0);
+            ins.arg[2] = (uint32_t)std::stoul(lenstr, nullptr, 0);
+        } catch(...) {
+            return bad("Invalid COPY operands");
+        }
+        ins.op = Opcode::COPY;
+        ins.text = text(dststr);
+        text(srcstr);
+    } else if (op == "FILL") {
+        // FILL <addr> <byte> <len>: set len bytes to a value
+        std::string addrstr, valstr, lenstr;
+        iss >> addrstr >> valstr >> lenstr;
+        if (addrstr.empty() || valstr.empty() || lenstr.empty()) return bad("Malformed FILL instruction");
+        int v = 0;
+        try {
+            ins.arg[0] = (uint32_t)std::stoul(addrstr, nullptr, 0);
+            v = std::stoi(valstr, nullptr, 0);
+            ins.arg[2] = (uint32_t)std::stoul(lenstr, nullptr, 0);
+        } catch(...) {
+            return bad("Invalid FILL operands");
+        }
+        ins.op = Opcode::FILL;
+        ins.arg[1] = (uint32_t)std::max(0, std::min(255, v));
+        ins.text = text(addrstr);
+    } else {
+        ins.op = Opcode::SKIP;
+        ins.text = text(op);
+    }
+    return ins;
+}
+
+inline void ProgramCompiler::finish() {
+    open_loops.clear();   // an unclosed FOR already points at itself
+
+    // Each instruction runs once per iteration of every loop around it; END
+    // is bookkeeping and does not count
+    std::vector<uint64_t> mult{1};
+    uint64_t total = 0;
+    for (size_t i = 0; i < prog.code.size(); ++i) {
+        const Instr &ins = prog.code[i];
+        if (ins.op == Opcode::END) {
+            mult.pop_back();
+            continue;
+        }
+        total += mult.back();
+        if (ins.op == Opcode::FOR && ins.arg[1] != i) {
+            int n = (int)ins.arg[0];
+            mult.push_back(std::min<uint64_t>(mult.back() * (uint64_t)std::max(0, n), INT_MAX));
+        }
+    }
+    prog.executed_total = (int)std::min<uint64_t>(total, INT_MAX);
+}
+
+// Compile source lines into a program, one instruction per line, adding
+// new variable names to the process's symbol table
+inline std::shared_ptr<const Program> compile_program(const std::vector<std::string> &lines, SymbolTable &symbols) {
+    auto prog = std::make_shared<Program>();
+    ProgramCompiler c(*prog, symbols);
+    prog->code.reserve(lines.size());
+    for (const auto &line : lines) prog->code.push_back(c.compile(line));
+    c.finish();
+    return prog;
+}
+
+#endif
@@ -1,198 +1,772 @@
 #include "MemoryManager.h"
+#include "PageCodec.h"
 #include <fstream>
-#include <sstream>
-#include <iomanip>
+#include <cstring>
 #include <algorithm>
 #include <iostream>
 #include <atomic>
+#include <thread>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
 
 // reference the VMSTAT atomic counters defined in osemulator.cpp
 extern std::atomic<uint64_t> num_paged_in;
 extern std::atomic<uint64_t> num_paged_out;
-
-// Backing store filename
-static const char *BACKING_STORE_FILE = "csopesy-backing-store.txt";
+extern std::atomic<uint64_t> tlb_hits;
+extern std::atomic<uint64_t> tlb_misses;
+extern std::atomic<uint64_t> num_background_page_outs;
+extern std::atomic<uint64_t> num_direct_reclaims;
+extern std::atomic<uint64_t> num_prefetched;
+extern std::atomic<uint64_t> prefetch_hits;
+extern std::atomic<uint64_t> prefetch_wasted;
+extern std::atomic<uint64_t> num_swap_outs;
+extern std::atomic<uint64_t> num_swap_ins;
+extern std::atomic<uint64_t> swap_out_bytes;
+extern std::atomic<uint64_t> swap_in_bytes;
+extern std::atomic<uint64_t> num_zero_pages;
+
+// Binary backing store: slot i holds one page at offset i * frame_bytes
+static const char *BACKING_STORE_FILE = "csopesy-backing-store.bin";
+
+// Human-readable export of the backing store (backing-dump command)
+static const char *BACKING_STORE_TEXT_FILE = "csopesy-backing-store.txt";
+
+// Slots mapped up front; the file doubles in size whenever it fills up
+static const size_t BACKING_MIN_SLOTS = 64;
+
+// TLB entry layout: page + 1 (16 bits) | frame (16 bits) | frame version (32 bits)
+static inline uint64_t tlb_pack(uint32_t page, uint32_t frame, uint32_t version) {
+    return ((uint64_t)(page + 1) << 48) | ((uint64_t)frame << 32) | version;
+}
+static inline uint32_t tlb_page(uint64_t e) { return (uint32_t)(e >> 48) - 1; }
+static inline uint32_t tlb_frame(uint64_t e) { return (uint32_t)(e >> 32) & 0xFFFF; }
+static inline uint32_t tlb_version(uint64_t e) { return (uint32_t)e; }
 
 std::unique_ptr<MemoryManager> mem_manager = nullptr;
 
 MemoryManager::MemoryManager() {}
 
 MemoryManager::~MemoryManager() {
-    std::lock_guard<std::mutex> lk(mtx);
-    persist_backing_store_locked();
+    stop_page_out_daemon();
+    std::unique_lock<std::shared_mutex> lk(store_mtx);
+    unmap_backing_locked();
 }
 
-void MemoryManager::init(uint32_t total_mem, uint32_t frame_size) {
-    std::lock_guard<std::mutex> lk(mtx);
+void MemoryManager::init(uint32_t total_mem, uint32_t frame_size, const std::string &policy_name) {
+    stop_page_out_daemon();
+    std::unique_lock<std::shared_mutex> slk(store_mtx);
+    std::lock_guard<std::mutex> flk(frame_mtx);
+    unmap_backing_locked();
     total_memory_bytes = total_mem;
     frame_bytes = frame_size;
     frames_count = (frame_bytes == 0) ? 0 : (total_memory_bytes / frame_bytes);
-    frame_owner.assign(frames_count, std::string());
-    frame_content.assign(frames_count, std::vector<uint8_t>(frame_bytes, 0));
-    free_frames.clear();
-    for (uint32_t i = 0; i < frames_count; ++i) free_frames.push_back((int)i);
-    fifo_queue.clear();
+    frame_table.assign(frames_count, FrameEntry());
+    // One contiguous, cache-line aligned arena of max-overall-mem bytes backs
+    // every frame; frame f starts at arena + f * frame_bytes.
+    size_t arena_bytes = std::max<size_t>(total_memory_bytes, (size_t)frames_count * frame_bytes);
+    arena.reset(static_cast<uint8_t *>(::operator new(arena_bytes, std::align_val_t(FRAME_ARENA_ALIGN))));
+    std::memset(arena.get(), 0, arena_bytes);
+    free_next.reset(new std::atomic<int>[frames_count]());
+    free_head.store(0);
+    free_count.store(0);
+    for (int i = (int)frames_count - 1; i >= 0; --i) push_free_frame(i);
+    policy = make_replacement_policy(policy_name);
+    policy_index = replacement_policy_index(policy->name());
+    frame_access.reset(new FrameAccess[frames_count]);
+    access_clock.store(0);
+    track_access = policy->uses_access();
+    policy->reset(frames_count, frame_access.get());
+    tlb_enabled = frames_count > 0 && frames_count <= 0xFFFF;
+    frame_version.reset(new std::atomic<uint32_t>[frames_count]());
+    frame_pins.reset(new std::atomic<uint32_t>[frames_count]());
+    frame_accessed.reset(new std::atomic<uint8_t>[frames_count]());
+    frame_dirty.reset(new std::atomic<uint8_t>[frames_count]());
+    frame_prefetched.reset(new std::atomic<uint8_t>[frames_count]());
+    read_ahead_pages = 0;
     backing_store.clear();
+    slots_used = 0;
+    free_slots.clear();
+    packed_pages = 0;
+    packed_bytes = 0;
+    zero_pages = 0;
+
+    // Pages left in the file by a previous session can never be mapped back to
+    // a live process (pids restart and every page starts out as a zero page),
+    // so start from an empty backing store.
+#ifndef _WIN32
+    backing_fd = ::open(BACKING_STORE_FILE, O_RDWR | O_CREAT | O_TRUNC, 0644);
+#endif
+}
 
-    // If backing file exists, try to load minimal contents (best-effort).
-    std::ifstream ifs(BACKING_STORE_FILE);
-    if (!ifs) return;
-    std::string line;
-    while (std::getline(ifs, line)) {
-        // Format: key <hex-bytes>
-        std::istringstream ss(line);
-        std::string key;
-        if (!(ss >> key)) continue;
-        std::string hex;
-        if (!(ss >> hex)) continue;
-        // hex is continuous hex; decode into bytes
-        std::vector<uint8_t> bytes;
-        bytes.reserve(hex.size()/2);
-        for (size_t i = 0; i + 1 < hex.size(); i += 2) {
-            unsigned int b;
-            std::stringstream hs;
-            hs << std::hex << hex.substr(i,2);
-            hs >> b;
-            bytes.push_back(static_cast<uint8_t>(b));
-        }
-        backing_store[key] = std::move(bytes);
+void MemoryManager::unmap_backing_locked() {
+#ifdef _WIN32
+    backing_heap.clear();
+    backing_heap.shrink_to_fit();
+#else
+    if (backing_map) ::munmap(backing_map, backing_capacity * (size_t)frame_bytes);
+    if (backing_fd != -1) ::close(backing_fd);
+    backing_fd = -1;
+#endif
+    backing_map = nullptr;
+    backing_capacity = 0;
+}
+
+bool MemoryManager::grow_backing_locked(size_t min_slots) {
+    if (min_slots <= backing_capacity) return true;
+    size_t cap = std::max(BACKING_MIN_SLOTS, backing_capacity * 2);
+    while (cap < min_slots) cap *= 2;
+    size_t bytes = cap * (size_t)frame_bytes;
+#ifdef _WIN32
+    // No mmap: keep the slots in a heap buffer with the same layout
+    backing_heap.resize(bytes, 0);
+    backing_map = backing_heap.data();
+#else
+    if (backing_fd == -1) return false;
+    if (::ftruncate(backing_fd, (off_t)bytes) != 0) return false;
+    void *m = ::mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, backing_fd, 0);
+    if (m == MAP_FAILED) return false;
+    if (backing_map) ::munmap(backing_map, backing_capacity * (size_t)frame_bytes);
+    backing_map = static_cast<uint8_t *>(m);
+#endif
+    backing_capacity = cap;
+    return true;
+}
+
+int MemoryManager::alloc_slot_locked() {
+    if (!free_slots.empty()) {
+        int s = free_slots.back();
+        free_slots.pop_back();
+        return s;
     }
+    if (!grow_backing_locked(slots_used + 1)) return -1;
+    return (int)slots_used++;
 }
 
-static inline std::string backing_hex_from_bytes(const std::vector<uint8_t> &v) {
-    std::ostringstream oss;
-    oss << std::hex << std::setfill('0');
-    for (uint8_t b : v) oss << std::setw(2) << (int)b;
-    return oss.str();
+bool MemoryManager::load_page_locked(const ProcMem &pm, int page, uint8_t *dst) {
+    auto pk = pm.packed.find(page);
+    if (pk != pm.packed.end()) {
+        if (!page_unpack(pk->second.data(), pk->second.size(), dst, frame_bytes))
+            std::memset(dst, 0, frame_bytes); // cannot happen: we packed it
+    } else if (pm.slot[page] != -1) {
+        std::memcpy(dst, slot_ptr(pm.slot[page]), frame_bytes);
+    } else {
+        std::memset(dst, 0, frame_bytes);
+        return false;
+    }
+    return true;
+}
+
+MemoryManager::BackingStoreStats MemoryManager::backing_store_stats() const {
+    std::shared_lock<std::shared_mutex> lk(store_mtx);
+    BackingStoreStats st;
+    st.raw_pages = slots_used - free_slots.size();
+    st.packed_pages = packed_pages;
+    st.packed_bytes = packed_bytes;
+    st.zero_pages = zero_pages;
+    st.page_bytes = frame_bytes;
+    return st;
 }
 
-void MemoryManager::persist_backing_store_locked() {
-    std::ofstream ofs(BACKING_STORE_FILE, std::ofstream::trunc);
+void MemoryManager::export_backing_store() {
+    std::unique_lock<std::shared_mutex> lk(store_mtx);
+#ifndef _WIN32
+    if (backing_map) ::msync(backing_map, backing_capacity * (size_t)frame_bytes, MS_ASYNC);
+#endif
+    std::ofstream ofs(BACKING_STORE_TEXT_FILE, std::ofstream::trunc);
     if (!ofs) return;
-    for (auto &kv : backing_store) {
-        ofs << kv.first << " " << backing_hex_from_bytes(kv.second) << "\n";
+    // Format: <procname>:<page> <hex-bytes>, by pid then page. Pages never
+    // written are zero pages and are left out.
+    static const char digits[] = "0123456789abcdef";
+    std::string hex(2 * (size_t)frame_bytes, '0');
+    std::vector<uint8_t> page_buf(frame_bytes);
+    std::vector<int> pids;
+    for (auto &kv : backing_store) pids.push_back(kv.first);
+    std::sort(pids.begin(), pids.end());
+    for (int pid : pids) {
+        const ProcMem &pm = backing_store.at(pid);
+        ProcessStub &proc = *pm.proc;
+        for (int page = 0; page < proc.num_pages; ++page) {
+            // Resident pages may be newer in their frame than in the slot. A
+            // page caught mid-eviction is shown from its slot (best effort).
+            int frame = proc.page_table[page].load();
+            bool pinned = false;
+            if (frame >= 0) {
+                uint32_t v = frame_version[frame].load();
+                frame_pins[frame].fetch_add(1);
+                pinned = frame_version[frame].load() == v && proc.page_table[page].load() == frame;
+                if (!pinned) unpin(frame);
+            }
+            const uint8_t *bytes = frame_ptr(frame);
+            if (!pinned) {
+                if (pm.slot[page] == -1 && !pm.packed.count(page)) continue;
+                load_page_locked(pm, page, page_buf.data());
+                bytes = page_buf.data();
+            }
+            for (size_t i = 0; i < frame_bytes; ++i) {
+                hex[2 * i] = digits[bytes[i] >> 4];
+                hex[2 * i + 1] = digits[bytes[i] & 0xF];
+            }
+            if (pinned) unpin(frame);
+            ofs << proc.name << ':' << page << ' ' << hex << '\n';
+        }
     }
-    ofs.close();
 }
 
-std::string MemoryManager::backing_key(const std::string &procname, int page_idx) const {
-    std::ostringstream ss;
-    ss << procname << ":" << page_idx;
-    return ss.str();
+int MemoryManager::pop_free_frame() {
+    uint64_t head = free_head.load();
+    for (;;) {
+        int top = (int)(uint32_t)head - 1;
+        if (top < 0) return -1;
+        uint64_t next = ((head >> 32) + 1) << 32 | (uint32_t)(free_next[top].load() + 1);
+        if (free_head.compare_exchange_weak(head, next)) {
+            free_count.fetch_sub(1);
+            return top;
+        }
+    }
 }
 
-int MemoryManager::find_free_frame_locked() {
-    if (!free_frames.empty()) {
-        int f = free_frames.back();
-        free_frames.pop_back();
-        return f;
+void MemoryManager::push_free_frame(int frame_index) {
+    uint64_t head = free_head.load();
+    for (;;) {
+        free_next[frame_index].store((int)(uint32_t)head - 1);
+        uint64_t next = ((head >> 32) + 1) << 32 | (uint32_t)(frame_index + 1);
+        if (free_head.compare_exchange_weak(head, next)) break;
     }
-    return -1;
+    free_count.fetch_add(1);
 }
 
-void MemoryManager::evict_frame_locked(int frame_index) {
-    if (frame_index < 0 || (size_t)frame_index >= frame_owner.size()) return;
-    const std::string owner = frame_owner[frame_index];
-    if (owner.empty()) return;
+int MemoryManager::pick_victim_locked() {
+    // The policy reads frame_access for the uses since it last looked
+    return policy->peek_victim();
+}
 
-    // owner format proc:page
-    auto pos = owner.find(':');
-    if (pos == std::string::npos) {
-        frame_owner[frame_index].clear();
-        std::fill(frame_content[frame_index].begin(), frame_content[frame_index].end(), 0);
-        return;
+void MemoryManager::retire_frame(int frame_index) {
+    // Invalidate cached translations, then wait out accesses that pinned
+    // the frame before they saw the new version.
+    frame_version[frame_index].fetch_add(1);
+    while (frame_pins[frame_index].load() != 0) std::this_thread::yield();
+    frame_accessed[frame_index].store(0, std::memory_order_relaxed);
+    if (frame_prefetched[frame_index].exchange(0)) prefetch_wasted++;
+}
+
+int MemoryManager::tlb_pin(ProcessStub &p, uint32_t page_idx) {
+    if (!tlb_enabled) return -1;
+    uint64_t e = p.tlb[page_idx % ProcessStub::TLB_ENTRIES].load(std::memory_order_acquire);
+    if (e == 0 || tlb_page(e) != page_idx) return -1;
+    int frame = (int)tlb_frame(e);
+    frame_pins[frame].fetch_add(1);
+    if (frame_version[frame].load() != tlb_version(e)) {
+        frame_pins[frame].fetch_sub(1);
+        return -1;
+    }
+    return frame;
+}
+
+void MemoryManager::unpin(int frame_index) {
+    frame_pins[frame_index].fetch_sub(1);
+}
+
+void MemoryManager::tlb_fill(ProcessStub &p, uint32_t page_idx, int frame_index, uint32_t version) {
+    if (!tlb_enabled || page_idx >= 0xFFFF) return;
+    p.tlb[page_idx % ProcessStub::TLB_ENTRIES].store(
+        tlb_pack(page_idx, (uint32_t)frame_index, version), std::memory_order_release);
+}
+
+int MemoryManager::pin_page(ProcessStub &p, uint32_t page_idx) {
+    int frame = tlb_pin(p, page_idx);
+    if (frame != -1) {
+        tlb_hits.fetch_add(1, std::memory_order_relaxed);
+    } else {
+        tlb_misses.fetch_add(1, std::memory_order_relaxed);
+        std::atomic<int> &pte = p.page_table[page_idx];
+        for (;;) {
+            int e = pte.load(std::memory_order_acquire);
+            if (e >= 0) {
+                // resident: pin, then make sure it was not retired meanwhile
+                uint32_t v = frame_version[e].load();
+                frame_pins[e].fetch_add(1);
+                if (frame_version[e].load() == v && pte.load() == e) {
+                    tlb_fill(p, page_idx, e, v);
+                    frame = e;
+                    break;
+                }
+                unpin(e);
+            } else if (e == PAGE_BUSY) {
+                // another core is moving this page
+                std::this_thread::yield();
+            } else if (pte.compare_exchange_strong(e, PAGE_BUSY)) {
+                // page fault: this core loads the page
+                frame = fault_in(p, page_idx);
+                if (frame == -1) return -1;
+                int prev = p.last_fault_page.exchange((int)page_idx);
+                if (prev >= 0 && prev == (int)page_idx - 1) read_ahead(p, page_idx);
+                break;
+            }
+        }
+    }
+    if (!frame_accessed[frame].load(std::memory_order_relaxed)) {
+        frame_accessed[frame].store(1, std::memory_order_relaxed);
+        // first touch of a read-ahead page: the stream is still sequential,
+        // so keep the window ahead of it
+        if (frame_prefetched[frame].load(std::memory_order_relaxed) && frame_prefetched[frame].exchange(0)) {
+            prefetch_hits++;
+            p.last_fault_page.store((int)page_idx);
+            read_ahead(p, page_idx);
+        }
+    }
+    if (track_access) {
+        frame_access[frame].last.store(access_clock.fetch_add(1, std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        frame_access[frame].count.fetch_add(1, std::memory_order_relaxed);
+    }
+    p.working_set.touch(page_idx);
+    return frame;
+}
+
+void MemoryManager::set_read_ahead(uint32_t pages) {
+    read_ahead_pages = std::min(pages, frames_count / 4);
+}
+
+uint32_t MemoryManager::read_ahead_window() const {
+    return read_ahead_pages;
+}
+
+void MemoryManager::read_ahead(ProcessStub &p, uint32_t page_idx) {
+    uint32_t last = std::min<uint32_t>(page_idx + read_ahead_pages, (uint32_t)p.num_pages - 1);
+    for (uint32_t q = page_idx + 1; q <= last; ++q) {
+        // skip pages that are resident or already being moved
+        int e = PAGE_NOT_RESIDENT;
+        if (!p.page_table[q].compare_exchange_strong(e, PAGE_BUSY)) continue;
+        int frame = fault_in(p, q, true);
+        if (frame == -1) return;
+        unpin(frame);
     }
-    std::string procname = owner.substr(0,pos);
-    int pageidx = std::stoi(owner.substr(pos+1));
+}
+
+void MemoryManager::start_page_out_daemon(uint32_t low_pct, uint32_t high_pct) {
+    stop_page_out_daemon();
+    if (low_pct == 0 || frames_count < 2) return;
+    high_pct = std::max(high_pct, low_pct);
+    // at least one frame, and never the whole memory
+    uint32_t low = std::min(std::max<uint32_t>(1, (uint32_t)((uint64_t)frames_count * low_pct / 100)), frames_count - 1);
+    kswapd_high = std::min(std::max(low, (uint32_t)((uint64_t)frames_count * high_pct / 100)), frames_count - 1);
+    kswapd_low.store(low);
+    kswapd_stop = false;
+    kswapd = std::thread(&MemoryManager::page_out_loop, this);
+}
+
+void MemoryManager::stop_page_out_daemon() {
+    if (!kswapd.joinable()) return;
+    {
+        std::lock_guard<std::mutex> lk(kswapd_mtx);
+        kswapd_stop = true;
+    }
+    kswapd_cv.notify_one();
+    kswapd.join();
+    kswapd_low.store(0);
+}
+
+void MemoryManager::page_out_loop() {
+    std::unique_lock<std::mutex> lk(kswapd_mtx);
+    while (!kswapd_stop) {
+        // faults notify without taking kswapd_mtx, so a wakeup can be missed;
+        // the timeout bounds how long that can go unnoticed
+        kswapd_cv.wait_for(lk, std::chrono::milliseconds(10),
+                           [this] { return kswapd_stop || free_count.load() < kswapd_low; });
+        if (kswapd_stop) break;
+        lk.unlock();
+        bool progress = false;
+        while (free_count.load() < kswapd_high && reclaim_one()) {
+            num_background_page_outs++;
+            progress = true;
+        }
+        lk.lock();
+        // nothing evictable right now (every frame is in transit): back off
+        if (!progress) kswapd_cv.wait_for(lk, std::chrono::milliseconds(10), [this] { return kswapd_stop; });
+    }
+}
+
+bool MemoryManager::reclaim_one() {
+    int frame;
+    ProcessStub *owner;
+    {
+        std::lock_guard<std::mutex> lk(frame_mtx);
+        frame = pick_victim_locked();
+        if (frame == -1) return false;
+        owner = take_frame_locked(frame);
+        owner->frames_evicting++;
+    }
+    evict_frame(frame, owner);
+    push_free_frame(frame);
+    return true;
+}
+
+int MemoryManager::grab_frame(bool &evicted) {
+    evicted = false;
+    if (frames_count == 0) return -1;
+    for (;;) {
+        int frame = pop_free_frame();
+        uint32_t low = kswapd_low.load(std::memory_order_relaxed);
+        if (low != 0 && free_count.load(std::memory_order_relaxed) < low)
+            kswapd_cv.notify_one();
+        if (frame != -1) return frame;
+        // evict the frame chosen by the replacement policy; taking it out of
+        // the policy makes this core its only owner
+        ProcessStub *owner = nullptr;
+        {
+            std::lock_guard<std::mutex> lk(frame_mtx);
+            frame = pick_victim_locked();
+            if (frame != -1) {
+                owner = take_frame_locked(frame);
+                owner->frames_evicting++;
+            }
+        }
+        if (frame != -1) {
+            // direct reclaim: the daemon is off or could not keep up
+            num_direct_reclaims++;
+            evict_frame(frame, owner);
+            evicted = true;
+            return frame;
+        }
+        // every frame is being loaded, evicted or freed by another core
+        std::this_thread::yield();
+    }
+}
+
+int MemoryManager::fault_in(ProcessStub &p, uint32_t page_idx, bool prefetch) {
+    std::atomic<int> &pte = p.page_table[page_idx];
+    uint64_t t0 = PagingStats::now_ns();
+    // Read-ahead runs with the faulting page pinned, so it must not evict
+    // (the victim could be pinned by this very core); it only takes free frames.
+    bool evicted = false;
+    int frame = prefetch ? pop_free_frame() : grab_frame(evicted);
+    if (frame == -1) {
+        pte.store(PAGE_NOT_RESIDENT);
+        return -1;
+    }
+    frame_pins[frame].fetch_add(1); // handed back to the caller pinned
+    std::shared_lock<std::shared_mutex> lk(store_mtx);
+    auto it = backing_store.find(p.id);
+    if (it == backing_store.end() || it->second.proc.get() != &p) {
+        // process has no memory allocated (or was freed meanwhile)
+        lk.unlock();
+        unpin(frame);
+        push_free_frame(frame);
+        pte.store(PAGE_NOT_RESIDENT);
+        return -1;
+    }
+    // load backing bytes into the frame; a page stored neither packed nor
+    // in a slot is a zero page
+    uint64_t t_io = PagingStats::now_ns();
+    if (load_page_locked(it->second, page_idx, frame_ptr(frame)))
+        stats.record_backing_read(PagingStats::now_ns() - t_io);
+    frame_dirty[frame].store(0);
+    frame_prefetched[frame].store(prefetch ? 1 : 0);
+
+    // set owner, publish the page, then make it evictable
+    frame_table[frame].pid = p.id;
+    frame_table[frame].page = (int)page_idx;
+    uint32_t v = frame_version[frame].load();
+    pte.store(frame, std::memory_order_release);
+    if (!prefetch) tlb_fill(p, page_idx, frame, v); // don't displace pages in use
+    {
+        std::lock_guard<std::mutex> flk(frame_mtx);
+        make_resident_locked(p, frame);
+    }
+    lk.unlock();
+
+    // increment paged-in counter (external atomic)
+    num_paged_in++;
+    if (prefetch) {
+        num_prefetched++;
+    } else {
+        p.page_faults.fetch_add(1, std::memory_order_relaxed);
+        stats.record_fault(evicted ? FAULT_EVICTION : FAULT_FREE_FRAME, PagingStats::now_ns() - t0);
+    }
+    return frame;
+}
+
+void MemoryManager::evict_frame(int frame_index, ProcessStub *owner) {
+    // Caller took the frame off the policy and the owner's list, and counted
+    // it in owner->frames_evicting, which keeps the owner alive until done.
+    const FrameEntry fe = frame_table[frame_index];
+    std::atomic<int> &pte = owner->page_table[fe.page];
+
+    // Claim the owner's page table entry, then wait out accesses in flight
+    pte.store(PAGE_BUSY);
+    retire_frame(frame_index);
+
+    // write back to the backing store only if the page was modified
+    if (frame_dirty[frame_index].exchange(0)) write_back(owner, fe.pid, fe.page, frame_index);
 
-    // save frame bytes to backing_store
-    backing_store[backing_key(procname, pageidx)] = frame_content[frame_index];
+    // drop the owner's TLB entry and mark the page not resident
+    std::atomic<uint64_t> &te = owner->tlb[fe.page % ProcessStub::TLB_ENTRIES];
+    uint64_t e = te.load();
+    if (e != 0 && tlb_page(e) == (uint32_t)fe.page) te.store(0);
+    pte.store(PAGE_NOT_RESIDENT, std::memory_order_release);
 
     // increment paged-out counter
     num_paged_out++;
 
-    // set owner->page_table entry invalid (if process still exists)
+    stats.record_eviction(policy_index);
+
+    // no need to clear the frame: page-in overwrites all of it
+    frame_table[frame_index].pid = -1;
+    frame_table[frame_index].page = -1;
+    owner->frames_evicting--;
+}
+
+void MemoryManager::write_back(const ProcessStub *owner, int pid, int page, int frame_index) {
+    uint64_t t0 = PagingStats::now_ns();
+    store_page(owner, pid, page, frame_index);
+    stats.record_backing_write(PagingStats::now_ns() - t0);
+}
+
+void MemoryManager::store_page(const ProcessStub *owner, int pid, int page, int frame_index) {
+    // The frame is retired, so it can be compressed before taking any lock.
+    // Zero pages are dropped, pages that pack to PACK_LIMIT or less are kept
+    // packed in memory, the rest go to a slot in the file.
+    const uint8_t *src = frame_ptr(frame_index);
+    static thread_local std::vector<uint8_t> buf;
+    size_t cap = (size_t)frame_bytes * PACK_LIMIT_NUM / PACK_LIMIT_DEN;
+    if (buf.size() < cap) buf.resize(cap);
+    bool zero = page_is_zero(src, frame_bytes);
+    size_t packed_len = zero ? 0 : page_pack(src, frame_bytes, buf.data(), cap);
+
+    if (!zero && packed_len == 0) {
+        std::shared_lock<std::shared_mutex> lk(store_mtx);
+        auto it = backing_store.find(pid);
+        if (it == backing_store.end() || it->second.proc.get() != owner) return; // freed meanwhile
+        int slot = it->second.slot[page];
+        if (slot != -1) {
+            std::memcpy(slot_ptr(slot), src, frame_bytes);
+            return;
+        }
+    }
+    // Changing how the page is stored (or its first raw write-back)
+    std::unique_lock<std::shared_mutex> lk(store_mtx);
+    auto it = backing_store.find(pid);
+    if (it == backing_store.end() || it->second.proc.get() != owner) return;
+    ProcMem &pm = it->second;
+    auto pk = pm.packed.find(page);
+    if (pk != pm.packed.end() && (zero || packed_len == 0)) {
+        packed_bytes -= pk->second.size();
+        packed_pages--;
+        pm.packed.erase(pk);
+        pk = pm.packed.end();
+    }
+    if (pm.zeroed[page] != (uint8_t)zero) {
+        pm.zeroed[page] = zero;
+        if (zero) zero_pages++; else zero_pages--;
+    }
+    int &slot = pm.slot[page];
+    if (zero || packed_len) {
+        if (slot != -1) {
+            free_slots.push_back(slot);
+            slot = -1;
+        }
+        if (zero) {
+            num_zero_pages++;
+            return;
+        }
+        if (pk == pm.packed.end()) {
+            pk = pm.packed.emplace(page, std::vector<uint8_t>()).first;
+            packed_pages++;
+        }
+        packed_bytes += packed_len - pk->second.size();
+        pk->second.assign(buf.begin(), buf.begin() + packed_len);
+        return;
+    }
+    if (slot == -1) slot = alloc_slot_locked();
+    if (slot == -1) {
+        std::cerr << "[MemoryManager] backing store full, page " << page << " of pid " << pid << " lost\n";
+        return;
+    }
+    std::memcpy(slot_ptr(slot), src, frame_bytes);
+}
+
+void MemoryManager::make_resident_locked(ProcessStub &p, int frame_index) {
+    FrameEntry &fe = frame_table[frame_index];
+    fe.resident = true;
+    fe.proc = &p;
+    fe.proc_prev = -1;
+    fe.proc_next = p.resident_frames;
+    if (p.resident_frames != -1) frame_table[p.resident_frames].proc_prev = frame_index;
+    p.resident_frames = frame_index;
+    // filling the frame counts as its first use, not as an access
+    frame_access[frame_index].last.store(access_clock.fetch_add(1, std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    frame_access[frame_index].count.store(0, std::memory_order_relaxed);
+    policy->on_load(frame_index);
+}
+
+ProcessStub *MemoryManager::take_frame_locked(int frame_index) {
+    // Out of the policy and off the owner's list; the caller now owns the frame
+    FrameEntry &fe = frame_table[frame_index];
+    ProcessStub *owner = fe.proc;
+    policy->on_remove(frame_index);
+    if (fe.proc_prev != -1) frame_table[fe.proc_prev].proc_next = fe.proc_next;
+    else fe.proc->resident_frames = fe.proc_next;
+    if (fe.proc_next != -1) frame_table[fe.proc_next].proc_prev = fe.proc_prev;
+    fe.resident = false;
+    fe.proc = nullptr;
+    fe.proc_prev = fe.proc_next = -1;
+    return owner;
+}
+
+void MemoryManager::release_process(int pid) {
+    // Under the exclusive store lock no page-in or write-back is in flight,
+    // so the process's list holds every frame it has. Take them, then drop
+    // the backing slots; later faults for this pid find no memory and fail.
+    std::vector<std::pair<int, int>> owned;   // (frame, page)
+    std::shared_ptr<ProcessStub> proc;
+    {
+        std::unique_lock<std::shared_mutex> lk(store_mtx);
+        auto it = backing_store.find(pid);
+        if (it == backing_store.end()) return;
+        proc = it->second.proc;
+        {
+            std::lock_guard<std::mutex> flk(frame_mtx);
+            while (proc->resident_frames != -1) {
+                int fi = proc->resident_frames;
+                owned.emplace_back(fi, frame_table[fi].page);
+                take_frame_locked(fi);
+            }
+        }
+        for (int s : it->second.slot) {
+            if (s != -1) free_slots.push_back(s);
+        }
+        for (auto &pk : it->second.packed) packed_bytes -= pk.second.size();
+        packed_pages -= it->second.packed.size();
+        zero_pages -= std::count(it->second.zeroed.begin(), it->second.zeroed.end(), 1);
+        backing_store.erase(it);
+    }
+
+    // Free the frames. Their slots are gone, so dirty data is dropped rather
+    // than written back, and page-in overwrites the frame, so no zero-fill.
+    // Retiring waits for in-flight accesses and must run unlocked: an access
+    // may hold a pin while it faults in another page.
+    for (auto &fp : owned) {
+        std::atomic<int> &pte = proc->page_table[fp.second];
+        pte.store(PAGE_BUSY);
+        retire_frame(fp.first);
+        frame_dirty[fp.first].store(0);
+        frame_table[fp.first].pid = -1;
+        frame_table[fp.first].page = -1;
+        pte.store(PAGE_NOT_RESIDENT);
+        push_free_frame(fp.first);
+    }
+    for (auto &te : proc->tlb) te.store(0);
+
+    // frames already picked for eviction still point into this process
+    while (proc->frames_evicting.load() != 0) std::this_thread::yield();
+}
+
+size_t MemoryManager::swap_out_process(const std::shared_ptr<ProcessStub>& p) {
+    if (!p || p->swapped_out.load()) return 0;
+    // Take every resident frame at once, remembering the pages for swap-in.
+    // The backing slots stay: the process keeps its memory, just not in RAM.
+    std::vector<std::pair<int, int>> owned;   // (frame, page)
     {
-        std::lock_guard<std::mutex> rlk(repository_mutex);
-        auto it = processes.find(procname);
-        if (it != processes.end()) {
-            auto p = it->second;
-            std::lock_guard<std::mutex> plk(p->mtx);
-            if (pageidx >= 0 && pageidx < (int)p->page_table.size())
-                p->page_table[pageidx] = -1;
+        std::unique_lock<std::shared_mutex> lk(store_mtx);
+        auto it = backing_store.find(p->id);
+        if (it == backing_store.end() || it->second.proc != p) return 0;
+        std::lock_guard<std::mutex> flk(frame_mtx);
+        while (p->resident_frames != -1) {
+            int fi = p->resident_frames;
+            owned.emplace_back(fi, frame_table[fi].page);
+            take_frame_locked(fi);
         }
+        it->second.swapped_pages.clear();
+        for (auto &fp : owned) it->second.swapped_pages.push_back(fp.second);
+        p->swapped_out.store(true);
     }
 
-    frame_owner[frame_index].clear();
-    std::fill(frame_content[frame_index].begin(), frame_content[frame_index].end(), 0);
+    size_t bytes = 0;
+    for (auto &fp : owned) {
+        std::atomic<int> &pte = p->page_table[fp.second];
+        pte.store(PAGE_BUSY);
+        retire_frame(fp.first);
+        if (frame_dirty[fp.first].exchange(0)) {
+            write_back(p.get(), p->id, fp.second, fp.first);
+            bytes += frame_bytes;
+        }
+        frame_table[fp.first].pid = -1;
+        frame_table[fp.first].page = -1;
+        pte.store(PAGE_NOT_RESIDENT);
+        push_free_frame(fp.first);
+    }
+    for (auto &te : p->tlb) te.store(0);
+    while (p->frames_evicting.load() != 0) std::this_thread::yield();
+
+    num_swap_outs++;
+    swap_out_bytes += bytes;
+    return bytes;
+}
+
+size_t MemoryManager::swap_in_process(const std::shared_ptr<ProcessStub>& p) {
+    if (!p || !p->swapped_out.load()) return 0;
+    std::vector<int> pages;
+    {
+        std::unique_lock<std::shared_mutex> lk(store_mtx);
+        auto it = backing_store.find(p->id);
+        if (it == backing_store.end() || it->second.proc != p) return 0;
+        pages.swap(it->second.swapped_pages);
+        p->swapped_out.store(false);
+    }
 
-    // Remove frame from FIFO queue (if present)
-    auto it = std::find(fifo_queue.begin(), fifo_queue.end(), frame_index);
-    if (it != fifo_queue.end()) fifo_queue.erase(it);
+    // Bring back the working set the process had when it was swapped out
+    size_t bytes = 0;
+    for (int page : pages) {
+        int e = PAGE_NOT_RESIDENT;
+        if (!p->page_table[page].compare_exchange_strong(e, PAGE_BUSY)) continue;
+        int frame = fault_in(*p, page);
+        if (frame == -1) break;
+        unpin(frame);
+        bytes += frame_bytes;
+    }
+
+    num_swap_ins++;
+    swap_in_bytes += bytes;
+    return bytes;
 }
 
 bool MemoryManager::allocate_process(const std::shared_ptr<ProcessStub>& p, uint32_t mem_bytes) {
     if (!p) return false;
-    std::lock_guard<std::mutex> lk(mtx);
     if (frame_bytes == 0) return false;
     if (mem_bytes == 0) return false;
     if (mem_bytes % frame_bytes != 0) return false; // must be multiple of frames (since mem per proc is power-of-two, config ensures this)
     int pages = static_cast<int>(mem_bytes / frame_bytes);
     if (pages <= 0) return false;
 
-    {
-        std::lock_guard<std::mutex> plk(p->mtx);
-        p->page_table.assign(pages, -1);
-        p->num_pages = pages;
-    }
+    // Re-allocating an existing process starts it over with fresh pages
+    release_process(p->id);
 
-    // Create zeroed backing entries for each page (empty / uninitialized)
-    std::vector<uint8_t> zeros(frame_bytes, 0);
-    for (int i = 0; i < pages; ++i) {
-        backing_store[backing_key(p->name, i)] = zeros;
-    }
+    std::unique_lock<std::shared_mutex> lk(store_mtx);
+    p->page_table.reset(new std::atomic<int>[pages]);
+    for (int i = 0; i < pages; ++i) p->page_table[i].store(PAGE_NOT_RESIDENT);
+    p->num_pages = pages;
+    p->working_set.reset(pages);
+
+    // Every page starts as a zero page: no backing slot until first written back
+    ProcMem &pm = backing_store[p->id];
+    pm.proc = p;
+    pm.slot.assign(pages, -1);
+    pm.zeroed.assign(pages, 0);
+    p->swapped_out.store(false);
 
-    persist_backing_store_locked();
     return true;
 }
 
 void MemoryManager::free_process(const std::shared_ptr<ProcessStub>& p) {
     if (!p) return;
-    std::lock_guard<std::mutex> lk(mtx);
-
-    // Free frames owned by this process
-    for (uint32_t fi = 0; fi < frame_owner.size(); ++fi) {
-        const std::string owner = frame_owner[fi];
-        if (owner.empty()) continue;
-        auto pos = owner.find(':');
-        if (pos == std::string::npos) continue;
-        std::string procname = owner.substr(0,pos);
-        if (procname == p->name) {
-            // write frame_content to backing store and free
-            int pageidx = std::stoi(owner.substr(pos+1));
-            backing_store[backing_key(procname, pageidx)] = frame_content[fi];
-            frame_owner[fi].clear();
-            std::fill(frame_content[fi].begin(), frame_content[fi].end(), 0);
-            // add to free list
-            free_frames.push_back((int)fi);
-            // remove from fifo if present
-            auto it = std::find(fifo_queue.begin(), fifo_queue.end(), (int)fi);
-            if (it != fifo_queue.end()) fifo_queue.erase(it);
-        }
-    }
-
-    // Remove backing store entries for this process
-    for (int i = 0; i < p->num_pages; ++i) {
-        backing_store.erase(backing_key(p->name, i));
-    }
-
-    persist_backing_store_locked();
+    release_process(p->id);
 }
 
 bool MemoryManager::ensure_page_loaded(const std::shared_ptr<ProcessStub>& p, uint32_t virtual_address) {
     if (!p) return false;
-    std::lock_guard<std::mutex> lk(mtx);
-
     if (frame_bytes == 0) return false;
 
     uint32_t page_idx = virtual_address / frame_bytes;
@@ -201,113 +775,108 @@ bool MemoryManager::ensure_page_loaded(const std::shared_ptr<ProcessStub>& p, ui
         return false;
     }
 
-    if (p->page_table[page_idx] != -1) return true; // already loaded
+    int frame = pin_page(*p, page_idx);
+    if (frame == -1) return false;
+    unpin(frame);
+    return true;
+}
 
-    // Need to load page -> page fault
-    int frame = find_free_frame_locked();
-    if (frame == -1) {
-        // evict via FIFO
-        if (fifo_queue.empty()) {
-            // no frames available (shouldn't happen), treat as failure
-            return false;
-        }
-        frame = fifo_queue.front();
-        fifo_queue.pop_front();
-        evict_frame_locked(frame);
-    }
-
-    // load backing bytes into frame_content
-    std::string key = backing_key(p->name, (int)page_idx);
-    auto it = backing_store.find(key);
-    if (it != backing_store.end()) {
-        const std::vector<uint8_t> &bytes = it->second;
-        // copy at most frame_bytes
-        size_t copylen = std::min(bytes.size(), frame_content[frame].size());
-        std::copy(bytes.begin(), bytes.begin() + copylen, frame_content[frame].begin());
-        if (copylen < frame_content[frame].size())
-            std::fill(frame_content[frame].begin() + copylen, frame_content[frame].end(), 0);
-    } else {
-        // initialize zeros
-        std::fill(frame_content[frame].begin(), frame_content[frame].end(), 0);
+template <typename Op>
+bool MemoryManager::access_span(const std::shared_ptr<ProcessStub>& p, uint32_t virtual_address,
+                                size_t len, bool write, Op op) {
+    if (!p) return false;
+    if (frame_bytes == 0) return false;
+    if ((uint64_t)virtual_address + len > (uint64_t)p->num_pages * frame_bytes) return false;
+
+    // Walk the span one page at a time, pinning each page (and faulting it
+    // in if needed) exactly once.
+    size_t done = 0;
+    while (done < len) {
+        uint32_t va = virtual_address + (uint32_t)done;
+        uint32_t page_idx = va / frame_bytes;
+        uint32_t offset = va % frame_bytes;
+        size_t n = std::min<size_t>(len - done, frame_bytes - offset);
+
+        int frame = pin_page(*p, page_idx);
+        if (frame == -1) return false;
+        op(frame_ptr(frame) + offset, done, n);
+        if (write) frame_dirty[frame].store(1, std::memory_order_relaxed);
+        unpin(frame);
+        done += n;
     }
+    return true;
+}
 
-    // set owner
-    frame_owner[frame] = backing_key(p->name, (int)page_idx);
-    fifo_queue.push_back(frame);
-
-    // update p->page_table
-    {
-        std::lock_guard<std::mutex> plk(p->mtx);
-        p->page_table[page_idx] = frame;
-    }
+bool MemoryManager::read_bytes(const std::shared_ptr<ProcessStub>& p, uint32_t virtual_address, uint8_t *dst, size_t len) {
+    return access_span(p, virtual_address, len, false,
+        [dst](uint8_t *mem, size_t done, size_t n) { std::memcpy(dst + done, mem, n); });
+}
 
-    // increment paged-in counter (external atomic)
-    num_paged_in++;
+bool MemoryManager::write_bytes(const std::shared_ptr<ProcessStub>& p, uint32_t virtual_address, const uint8_t *src, size_t len) {
+    return access_span(p, virtual_address, len, true,
+        [src](uint8_t *mem, size_t done, size_t n) { std::memcpy(mem, src + done, n); });
+}
 
-    persist_backing_store_locked(); // keep backing store consistent (optional)
-    return true;
+bool MemoryManager::fill(const std::shared_ptr<ProcessStub>& p, uint32_t virtual_address, uint8_t value, size_t len) {
+    return access_span(p, virtual_address, len, true,
+        [value](uint8_t *mem, size_t, size_t n) { std::memset(mem, value, n); });
 }
 
 bool MemoryManager::read_u16(const std::shared_ptr<ProcessStub>& p, uint32_t virtual_address, uint16_t &out) {
     if (!p) return false;
-    std::unique_lock<std::mutex> lk(mtx);
     if (frame_bytes == 0) return false;
 
     uint32_t page_idx = virtual_address / frame_bytes;
     uint32_t offset = virtual_address % frame_bytes;
     if ((int)page_idx >= p->num_pages) return false;
-    if (offset + 2 > frame_bytes) return false; // cannot cross page boundary in this simplified model
-
-    int frame = p->page_table[page_idx];
-    if (frame == -1) {
-        // Need to load it: release lock, call ensure_page_loaded (will re-lock internally), then relock
-        lk.unlock();
-        if (!ensure_page_loaded(p, virtual_address)) return false;
-        lk.lock();
-        frame = p->page_table[page_idx];
-        if (frame == -1) return false;
+    if (offset + 2 > frame_bytes) {
+        // value straddles two pages
+        uint8_t b[2];
+        if (!read_bytes(p, virtual_address, b, 2)) return false;
+        out = static_cast<uint16_t>(b[0] | (b[1] << 8));
+        return true;
     }
 
+    int frame = pin_page(*p, page_idx);
+    if (frame == -1) return false;
+
     // read two bytes (little-endian)
-    uint8_t b0 = frame_content[frame][offset];
-    uint8_t b1 = frame_content[frame][offset + 1];
-    out = static_cast<uint16_t>(b0 | (b1 << 8));
+    const uint8_t *b = frame_ptr(frame) + offset;
+    out = static_cast<uint16_t>(b[0] | (b[1] << 8));
+    unpin(frame);
     return true;
 }
 
 bool MemoryManager::write_u16(const std::shared_ptr<ProcessStub>& p, uint32_t virtual_address, uint16_t value) {
     if (!p) return false;
-    std::unique_lock<std::mutex> lk(mtx);
     if (frame_bytes == 0) return false;
 
     uint32_t page_idx = virtual_address / frame_bytes;
     uint32_t offset = virtual_address % frame_bytes;
     if ((int)page_idx >= p->num_pages) return false;
-    if (offset + 2 > frame_bytes) return false; // cannot cross page boundary in this simple model
-
-    int frame = p->page_table[page_idx];
-    if (frame == -1) {
-        // Need to load it
-        lk.unlock();
-        if (!ensure_page_loaded(p, virtual_address)) return false;
-        lk.lock();
-        frame = p->page_table[page_idx];
-        if (frame == -1) return false;
+    if (offset + 2 > frame_bytes) {
+        // value straddles two pages
+        uint8_t b[2] = { static_cast<uint8_t>(value & 0xFF), static_cast<uint8_t>((value >> 8) & 0xFF) };
+        return write_bytes(p, virtual_address, b, 2);
     }
 
+    int frame = pin_page(*p, page_idx);
+    if (frame == -1) return false;
+
     // write two bytes little-endian
-    frame_content[frame][offset] = static_cast<uint8_t>(value & 0xFF);
-    frame_content[frame][offset + 1] = static_cast<uint8_t>((value >> 8) & 0xFF);
+    uint8_t *b = frame_ptr(frame) + offset;
+    b[0] = static_cast<uint8_t>(value & 0xFF);
+    b[1] = static_cast<uint8_t>((value >> 8) & 0xFF);
 
-    // Also update backing_store copy so it remains consistent when evicted
-    std::string key = frame_owner[frame];
-    if (!key.empty()) {
-        backing_store[key] = frame_content[frame];
-    }
+    // The backing store copy is refreshed when the dirty frame is evicted
+    frame_dirty[frame].store(1, std::memory_order_relaxed);
+    unpin(frame);
 
     // Note: a write doesn't immediately count as paged-out; evictions increment paged-out.
     return true;
 }
 
 uint32_t MemoryManager::frame_count() const { return frames_count; }
-uint32_t MemoryManager::frame_size() const { return frame_bytes; }
\ No newline at end of file
+uint32_t MemoryManager::frame_size() const { return frame_bytes; }
+const char *MemoryManager::replacement_policy_name() const { return policy ? policy->name() : "fifo"; }
+PagingStats::Snapshot MemoryManager::paging_stats() const { return stats.snapshot(); }
\ No newline at end of file
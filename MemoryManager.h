@@ -3,13 +3,19 @@
 
 #include <cstdint>
 #include <vector>
-#include <deque>
 #include <string>
 #include <unordered_map>
 #include <mutex>
+#include <shared_mutex>
+#include <atomic>
 #include <memory>
+#include <new>
+#include <thread>
+#include <condition_variable>
 
 #include "process.h"
+#include "ReplacementPolicy.h"
+#include "PagingStats.h"
 
 class MemoryManager {
 public:
@@ -17,8 +23,9 @@ public:
     ~MemoryManager();
 
     // Initialize memory manager before allocator use
-    // total_mem and frame_size are in bytes
-    void init(uint32_t total_mem, uint32_t frame_size);
+    // total_mem and frame_size are in bytes; policy is a page replacement
+    // policy name ("fifo", "lru", "clock" or "lfu")
+    void init(uint32_t total_mem, uint32_t frame_size, const std::string &policy = "fifo");
 
     // Allocate metadata for a process (does NOT immediately allocate frames).
     // Returns true on success (valid sizes), false if rejected.
@@ -37,40 +44,215 @@ public:
     bool read_u16(const std::shared_ptr<ProcessStub>& p, uint32_t virtual_address, uint16_t &out);
     bool write_u16(const std::shared_ptr<ProcessStub>& p, uint32_t virtual_address, uint16_t value);
 
+    // Bulk access to len bytes starting at a virtual address. Spans may cross
+    // page boundaries; each page is faulted in at most once per call. Returns
+    // false if any part of the span lies outside the process's memory.
+    bool read_bytes(const std::shared_ptr<ProcessStub>& p, uint32_t virtual_address, uint8_t *dst, size_t len);
+    bool write_bytes(const std::shared_ptr<ProcessStub>& p, uint32_t virtual_address, const uint8_t *src, size_t len);
+    bool fill(const std::shared_ptr<ProcessStub>& p, uint32_t virtual_address, uint8_t value, size_t len);
+
+    // Whole-process swapping. swap_out_process writes back and frees every
+    // resident frame of the process in one pass and marks it swapped out; its
+    // backing slots are kept. swap_in_process reloads the pages that were
+    // resident at swap-out. Both return the bytes moved. The caller picks
+    // processes that are not running.
+    size_t swap_out_process(const std::shared_ptr<ProcessStub>& p);
+    size_t swap_in_process(const std::shared_ptr<ProcessStub>& p);
+
+    // Background page-out ("kswapd"): once free frames drop below low_pct
+    // percent of all frames, a thread evicts cold pages until high_pct percent
+    // are free, so faults normally find a free frame. low_pct == 0 disables
+    // it. init() and the destructor stop the thread.
+    void start_page_out_daemon(uint32_t low_pct, uint32_t high_pct);
+    void stop_page_out_daemon();
+
+    // Read-ahead: on a sequential fault, also load the next `pages` pages of
+    // the process into free frames (read-ahead never evicts, so it relies on
+    // the page-out daemon once memory fills up). 0 disables it. The window is
+    // capped at a quarter of all frames.
+    void set_read_ahead(uint32_t pages);
+    uint32_t read_ahead_window() const;
+
+    // Write the backing store as text (csopesy-backing-store.txt) for inspection.
+    void export_backing_store();
+
+    // Backing store usage: pages in file slots, pages kept compressed in
+    // memory and their packed size, and pages written back as all zeros,
+    // which take no space at all. Only pages of live processes count.
+    struct BackingStoreStats {
+        size_t raw_pages = 0;
+        size_t packed_pages = 0;
+        size_t packed_bytes = 0;
+        size_t zero_pages = 0;
+        uint32_t page_bytes = 0;
+    };
+    BackingStoreStats backing_store_stats() const;
+
     // Stats
     uint32_t frame_count() const;
     uint32_t frame_size() const;
+    const char *replacement_policy_name() const;
+
+    // Fault counts and latency histograms, evictions per policy and backing
+    // store I/O time, summed over cores. Per-process fault counts are kept in
+    // ProcessStub::page_faults.
+    PagingStats::Snapshot paging_stats() const;
 
 private:
+    // Page table entry values other than a frame number
+    static constexpr int PAGE_NOT_RESIDENT = -1;
+    static constexpr int PAGE_BUSY = -2;        // being faulted in or evicted
+
+    // Inverted page table entry: which (pid, page) currently occupies a frame.
+    // pid/page are written by the core that loads the frame before it is
+    // published. The rest is guarded by frame_mtx: resident (frame is tracked
+    // by the policy) and the links of the owner's resident frame list.
+    struct FrameEntry {
+        int pid = -1;   // -1 = frame is free
+        int page = -1;
+        bool resident = false;
+        ProcessStub *proc = nullptr;
+        int proc_prev = -1, proc_next = -1;
+    };
+
+    // Per-process memory record, keyed by pid. A saved page lives in one of
+    // three places: packed[page] holds it compressed (PageCodec.h), slot[page]
+    // is the backing store slot holding it uncompressed, and a page in
+    // neither is a zero page (never written back, or all zeros when it was).
+    struct ProcMem {
+        std::shared_ptr<ProcessStub> proc;
+        std::vector<int> slot;
+        std::unordered_map<int, std::vector<uint8_t>> packed;
+        std::vector<uint8_t> zeroed;      // written back as all zeros
+        std::vector<int> swapped_pages;   // resident when swapped out
+    };
+
     // internal helpers
-    int find_free_frame_locked();
-    void evict_frame_locked(int frame_index);
-    std::string backing_key(const std::string &procname, int page_idx) const;
-    void persist_backing_store_locked(); // writes backing store map to file
+    int pin_page(ProcessStub &p, uint32_t page_idx);   // returns pinned frame, faulting if needed
+    int fault_in(ProcessStub &p, uint32_t page_idx, bool prefetch = false); // entry already claimed (PAGE_BUSY)
+    void read_ahead(ProcessStub &p, uint32_t page_idx);
+    int grab_frame(bool &evicted);
+    int pick_victim_locked();
+    void make_resident_locked(ProcessStub &p, int frame_index);
+    ProcessStub *take_frame_locked(int frame_index);
+    void evict_frame(int frame_index, ProcessStub *owner);
+    void write_back(const ProcessStub *owner, int pid, int page, int frame_index);
+    void store_page(const ProcessStub *owner, int pid, int page, int frame_index);
+    void release_process(int pid);
+    void retire_frame(int frame_index);
+    int tlb_pin(ProcessStub &p, uint32_t page_idx);
+    void unpin(int frame_index);
+    void tlb_fill(ProcessStub &p, uint32_t page_idx, int frame_index, uint32_t version);
+    void page_out_loop();
+    bool reclaim_one();
+    int pop_free_frame();
+    void push_free_frame(int frame_index);
+    template <typename Op>
+    bool access_span(const std::shared_ptr<ProcessStub>& p, uint32_t virtual_address,
+                     size_t len, bool write, Op op);
+    int alloc_slot_locked();
+    bool load_page_locked(const ProcMem &pm, int page, uint8_t *dst);   // false for a zero page
+    bool grow_backing_locked(size_t min_slots);
+    void unmap_backing_locked();
+    uint8_t *slot_ptr(int slot) { return backing_map + (size_t)slot * frame_bytes; }
+    uint8_t *frame_ptr(int frame) { return arena.get() + (size_t)frame * frame_bytes; }
 
-    mutable std::mutex mtx;
+    // Locking. There is no lock on the access path: page table entries are
+    // atomics, claimed with a CAS to PAGE_BUSY by whichever core faults the
+    // page in or evicts it, so faults on different pages run in parallel.
+    //  - frame_mtx guards the replacement policy and FrameEntry::resident.
+    //    Taking a frame out of the policy makes the taker its sole owner.
+    //  - store_mtx guards the backing store map, the slot allocator and the
+    //    mapping: shared for page-in/write-back memcpys, exclusive for
+    //    allocate/free/growth. Page-in keeps it until the frame is resident,
+    //    so free sees every frame the process holds. Lock order: store_mtx,
+    //    then frame_mtx.
+    mutable std::mutex frame_mtx;
+    mutable std::shared_mutex store_mtx;
 
     uint32_t total_memory_bytes = 0;
     uint32_t frame_bytes = 0;
     uint32_t frames_count = 0;
 
-    // For each frame: owner key "<procname>:<page>" or empty
-    std::vector<std::string> frame_owner;
+    // For each frame: owning (pid, page), indexed by frame number
+    std::vector<FrameEntry> frame_table;
+
+    // Physical memory: all frames in one aligned allocation
+    static constexpr size_t FRAME_ARENA_ALIGN = 64;
+    struct ArenaDeleter {
+        void operator()(uint8_t *p) const { ::operator delete(p, std::align_val_t(FRAME_ARENA_ALIGN)); }
+    };
+    std::unique_ptr<uint8_t, ArenaDeleter> arena;
+
+    // Free frames: lock-free stack linked through free_next. The head packs
+    // an ABA tag (high 32 bits) with the top frame + 1 (low 32 bits, 0 = empty).
+    std::atomic<uint64_t> free_head{0};
+    std::unique_ptr<std::atomic<int>[]> free_next;
+    std::atomic<uint32_t> free_count{0};
+
+    // Page-out daemon state. Watermarks are in frames; the daemon sleeps on
+    // kswapd_cv until a fault pops the free count below kswapd_low.
+    std::thread kswapd;
+    std::mutex kswapd_mtx;
+    std::condition_variable kswapd_cv;
+    bool kswapd_stop = false;
+    std::atomic<uint32_t> kswapd_low{0};   // 0 = daemon not running
+    uint32_t kswapd_high = 0;
+
+    // Page replacement policy tracking the resident frames
+    std::unique_ptr<ReplacementPolicy> policy;
+    int policy_index = 0;   // into REPLACEMENT_POLICY_NAMES
+
+    // Paging instrumentation (see PagingStats.h)
+    PagingStats stats;
+
+    // Frame pinning. Every access pins the frame it touches; retiring a frame
+    // (evict/free) bumps its version, which invalidates cached translations
+    // and makes late pins back off, then waits for in-flight pins to drain.
+    // A TLB entry records the version it was filled at. frame_accessed marks
+    // frames touched since they were filled.
+    bool tlb_enabled = false;
+    std::unique_ptr<std::atomic<uint32_t>[]> frame_version;
+    std::unique_ptr<std::atomic<uint32_t>[]> frame_pins;
+    std::unique_ptr<std::atomic<uint8_t>[]> frame_accessed;
+
+    // Recency and frequency of use per frame for the replacement policy,
+    // recorded lock-free by every access (only if the policy uses them);
+    // access_clock orders the accesses.
+    bool track_access = false;
+    std::unique_ptr<FrameAccess[]> frame_access;
+    std::atomic<uint64_t> access_clock{0};
 
-    // Simulated bytes stored per frame
-    std::vector<std::vector<uint8_t>> frame_content;
+    // Read-ahead window in pages, and a per-frame flag marking pages loaded
+    // by read-ahead that have not been touched yet (hit on first access,
+    // wasted if the frame is retired first).
+    uint32_t read_ahead_pages = 0;
+    std::unique_ptr<std::atomic<uint8_t>[]> frame_prefetched;
 
-    // Free frames list
-    std::vector<int> free_frames;
+    // Dirty bit per frame: set by writes, cleared on page-in. Only dirty frames
+    // are copied back to their backing store slot on eviction.
+    std::unique_ptr<std::atomic<uint8_t>[]> frame_dirty;
 
-    // FIFO replacement queue of frame indices
-    std::deque<int> fifo_queue;
+    // Processes with allocated memory: pid -> backing store slots
+    std::unordered_map<int, ProcMem> backing_store;
 
-    // Backing store: map key -> raw bytes (text file persisted)
-    std::unordered_map<std::string, std::vector<uint8_t>> backing_store;
+    // Backing store file, memory-mapped: one frame_bytes-sized slot per page
+    // that did not compress. Paging in/out is a memcpy to/from the mapping.
+    int backing_fd = -1;
+    uint8_t *backing_map = nullptr;
+    size_t backing_capacity = 0;          // slots currently mapped
+#ifdef _WIN32
+    std::vector<uint8_t> backing_heap;    // stands in for the mapping
+#endif
+    size_t slots_used = 0;                // slots handed out so far
+    std::vector<int> free_slots;
 
-    // helper counters (externs expected by vmstat)
-    // (we will update extern counters from osemulator through functions when paging occurs)
+    // Compressed pages: a page is kept packed if that saves at least a
+    // quarter of it, otherwise it is stored raw in a slot.
+    static constexpr size_t PACK_LIMIT_NUM = 3, PACK_LIMIT_DEN = 4;
+    size_t packed_pages = 0;
+    size_t packed_bytes = 0;
+    size_t zero_pages = 0;                // pages with zeroed set
 };
 
 extern std::unique_ptr<MemoryManager> mem_manager;
@@ -0,0 +1,77 @@
+#ifndef PAGE_CODEC_H
+#define PAGE_CODEC_H
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+
+// Compression for backing store pages. Pages are mostly zeros or sparse
+// 16-bit values, so a byte-oriented run-length code (PackBits style) gets
+// most of the benefit at memcpy-like speed. Control byte c:
+//   c <  0x80: the next c + 1 bytes are copied literally (runs of 1..128)
+//   c >= 0x80: the next byte is repeated c - 0x80 + 3 times (runs of 3..130)
+
+inline bool page_is_zero(const uint8_t *p, size_t n) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        uint64_t w;
+        std::memcpy(&w, p + i, 8);
+        if (w) return false;
+    }
+    for (; i < n; ++i)
+        if (p[i]) return false;
+    return true;
+}
+
+// Packs n bytes into dst. Returns the packed size, or 0 if it would not fit
+// in cap bytes (the page is not worth compressing).
+inline size_t page_pack(const uint8_t *src, size_t n, uint8_t *dst, size_t cap) {
+    size_t in = 0, out = 0;
+    while (in < n) {
+        // length of the run of equal bytes starting here
+        size_t run = 1;
+        while (in + run < n && run < 130 && src[in + run] == src[in]) ++run;
+        if (run >= 3) {
+            if (out + 2 > cap) return 0;
+            dst[out++] = static_cast<uint8_t>(0x80 + run - 3);
+            dst[out++] = src[in];
+            in += run;
+            continue;
+        }
+        // literal run: up to the next run of 3 equal bytes
+        size_t lit = 0;
+        while (in + lit < n && lit < 128) {
+            if (in + lit + 2 < n && src[in + lit] == src[in + lit + 1] && src[in + lit] == src[in + lit + 2]) break;
+            ++lit;
+        }
+        if (out + 1 + lit > cap) return 0;
+        dst[out++] = static_cast<uint8_t>(lit - 1);
+        std::memcpy(dst + out, src + in, lit);
+        out += lit;
+        in += lit;
+    }
+    return out;
+}
+
+// Unpacks into exactly n bytes. Returns false on malformed input.
+inline bool page_unpack(const uint8_t *src, size_t len, uint8_t *dst, size_t n) {
+    size_t in = 0, out = 0;
+    while (in < len) {
+        uint8_t c = src[in++];
+        if (c < 0x80) {
+            size_t lit = (size_t)c + 1;
+            if (in + lit > len || out + lit > n) return false;
+            std::memcpy(dst + out, src + in, lit);
+            in += lit;
+            out += lit;
+        } else {
+            size_t run = (size_t)c - 0x80 + 3;
+            if (in >= len || out + run > n) return false;
+            std::memset(dst + out, src[in++], run);
+            out += run;
+        }
+    }
+    return out == n;
+}
+
+#endif
@@ -0,0 +1,112 @@
+#ifndef PAGING_STATS_H
+#define PAGING_STATS_H
+
+#include <cstdint>
+#include <atomic>
+#include <chrono>
+
+// Paging instrumentation: fault counts and service latency histograms per
+// fault path, evictions per replacement policy, and backing store I/O time.
+// Counters are sharded by thread so each core bumps its own cache lines on
+// the fault path; snapshot() sums the shards.
+
+enum FaultPath {
+    FAULT_FREE_FRAME = 0,   // a free frame was available
+    FAULT_EVICTION,         // the faulting core had to evict a page first
+    FAULT_PATHS
+};
+
+class PagingStats {
+public:
+    static constexpr int SHARDS = 16;
+    // Bucket 0 is < 1us, bucket i is [2^(i-1), 2^i) us, the last is open-ended
+    static constexpr int LATENCY_BUCKETS = 16;
+    static constexpr int POLICIES = 4;   // indexed like REPLACEMENT_POLICY_NAMES
+
+    struct Snapshot {
+        uint64_t faults[FAULT_PATHS] = {};
+        uint64_t fault_ns[FAULT_PATHS] = {};
+        uint64_t latency[FAULT_PATHS][LATENCY_BUCKETS] = {};
+        uint64_t evictions[POLICIES] = {};
+        uint64_t backing_reads = 0, backing_read_ns = 0;
+        uint64_t backing_writes = 0, backing_write_ns = 0;
+    };
+
+    static uint64_t now_ns() {
+        return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    static int latency_bucket(uint64_t ns) {
+        uint64_t us = ns / 1000;
+        int b = 0;
+        while (us && b < LATENCY_BUCKETS - 1) { us >>= 1; ++b; }
+        return b;
+    }
+
+    // Upper bound of a latency bucket in microseconds (0 for the last one)
+    static uint64_t bucket_limit_us(int b) { return b < LATENCY_BUCKETS - 1 ? (uint64_t)1 << b : 0; }
+
+    void record_fault(FaultPath path, uint64_t ns) {
+        Shard &s = local();
+        s.faults[path].fetch_add(1, std::memory_order_relaxed);
+        s.fault_ns[path].fetch_add(ns, std::memory_order_relaxed);
+        s.latency[path][latency_bucket(ns)].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void record_eviction(int policy) {
+        if (policy >= 0 && policy < POLICIES) local().evictions[policy].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void record_backing_read(uint64_t ns) {
+        Shard &s = local();
+        s.backing_reads.fetch_add(1, std::memory_order_relaxed);
+        s.backing_read_ns.fetch_add(ns, std::memory_order_relaxed);
+    }
+
+    void record_backing_write(uint64_t ns) {
+        Shard &s = local();
+        s.backing_writes.fetch_add(1, std::memory_order_relaxed);
+        s.backing_write_ns.fetch_add(ns, std::memory_order_relaxed);
+    }
+
+    Snapshot snapshot() const {
+        Snapshot out;
+        for (const Shard &s : shards_) {
+            for (int p = 0; p < FAULT_PATHS; ++p) {
+                out.faults[p] += s.faults[p].load(std::memory_order_relaxed);
+                out.fault_ns[p] += s.fault_ns[p].load(std::memory_order_relaxed);
+                for (int b = 0; b < LATENCY_BUCKETS; ++b)
+                    out.latency[p][b] += s.latency[p][b].load(std::memory_order_relaxed);
+            }
+            for (int i = 0; i < POLICIES; ++i) out.evictions[i] += s.evictions[i].load(std::memory_order_relaxed);
+            out.backing_reads += s.backing_reads.load(std::memory_order_relaxed);
+            out.backing_read_ns += s.backing_read_ns.load(std::memory_order_relaxed);
+            out.backing_writes += s.backing_writes.load(std::memory_order_relaxed);
+            out.backing_write_ns += s.backing_write_ns.load(std::memory_order_relaxed);
+        }
+        return out;
+    }
+
+private:
+    struct alignas(64) Shard {
+        std::atomic<uint64_t> faults[FAULT_PATHS] = {};
+        std::atomic<uint64_t> fault_ns[FAULT_PATHS] = {};
+        std::atomic<uint64_t> latency[FAULT_PATHS][LATENCY_BUCKETS] = {};
+        std::atomic<uint64_t> evictions[POLICIES] = {};
+        std::atomic<uint64_t> backing_reads{0}, backing_read_ns{0};
+        std::atomic<uint64_t> backing_writes{0}, backing_write_ns{0};
+    };
+
+    // Threads are spread over the shards in the order they first record
+    // something, so the scheduler's core threads each get their own.
+    Shard &local() {
+        static std::atomic<unsigned> next_shard{0};
+        thread_local unsigned shard = next_shard.fetch_add(1) % SHARDS;
+        return shards_[shard];
+    }
+
+    Shard shards_[SHARDS];
+};
+
+#endif
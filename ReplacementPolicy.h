@@ -0,0 +1,273 @@
+#ifndef REPLACEMENT_POLICY_H
+#define REPLACEMENT_POLICY_H
+
+#include <cstdint>
+#include <vector>
+#include <list>
+#include <string>
+#include <memory>
+#include <atomic>
+
+// Doubly-linked list of frame indices threaded through per-frame prev/next
+// arrays, so insert, unlink and move are O(1) with no allocation.
+class FrameList {
+public:
+    void reset(uint32_t frames) {
+        prev_.assign(frames, -1);
+        next_.assign(frames, -1);
+        linked_.assign(frames, 0);
+        head_ = tail_ = -1;
+        size_ = 0;
+    }
+
+    bool contains(int f) const { return f >= 0 && f < (int)linked_.size() && linked_[f]; }
+    bool empty() const { return size_ == 0; }
+    size_t size() const { return size_; }
+    int front() const { return head_; }
+    int next(int f) const { return next_[f]; }
+
+    void push_back(int f) {
+        if (contains(f)) return;
+        prev_[f] = tail_;
+        next_[f] = -1;
+        if (tail_ != -1) next_[tail_] = f; else head_ = f;
+        tail_ = f;
+        linked_[f] = 1;
+        ++size_;
+    }
+
+    void remove(int f) {
+        if (!contains(f)) return;
+        if (prev_[f] != -1) next_[prev_[f]] = next_[f]; else head_ = next_[f];
+        if (next_[f] != -1) prev_[next_[f]] = prev_[f]; else tail_ = prev_[f];
+        prev_[f] = next_[f] = -1;
+        linked_[f] = 0;
+        --size_;
+    }
+
+private:
+    std::vector<int> prev_, next_;
+    std::vector<uint8_t> linked_;
+    int head_ = -1, tail_ = -1;
+    size_t size_ = 0;
+};
+
+// Accesses to a frame, recorded by the memory manager on every access
+// without taking a lock or calling the policy: the access clock at the
+// latest access, and the number of accesses since the frame was filled.
+// Policies read them when they pick a victim.
+struct FrameAccess {
+    std::atomic<uint64_t> last{0};
+    std::atomic<uint64_t> count{0};
+};
+
+// Page replacement policy over resident frames. The memory manager reports
+// when a frame is filled or released; peek_victim() names the next frame to
+// evict (the manager then evicts it and calls on_remove). Policies that
+// order frames by use read the FrameAccess array passed to reset() and
+// refile frames used since they last looked, so the access path never
+// touches the policy. All operations are O(1) amortized: a frame is only
+// refiled one step for an access recorded since it was last filed.
+class ReplacementPolicy {
+public:
+    virtual ~ReplacementPolicy() = default;
+    virtual const char *name() const = 0;
+    virtual bool uses_access() const { return true; }   // false: accesses need not be recorded
+    virtual void reset(uint32_t frames, const FrameAccess *access) = 0;
+    virtual void on_load(int frame) = 0;
+    virtual void on_remove(int frame) = 0;
+    virtual int peek_victim() = 0;   // -1 if no frame is resident
+};
+
+// First-in first-out: evict the frame that was loaded earliest.
+class FifoPolicy : public ReplacementPolicy {
+public:
+    const char *name() const override { return "fifo"; }
+    bool uses_access() const override { return false; }
+    void reset(uint32_t frames, const FrameAccess *) override { order.reset(frames); }
+    void on_load(int frame) override { order.push_back(frame); }
+    void on_remove(int frame) override { order.remove(frame); }
+    int peek_victim() override { return order.front(); }
+
+private:
+    FrameList order;
+};
+
+// Least recently used. Frames are listed in the order they were filed,
+// oldest first. A frame at the front that has been used since it was filed
+// moves to the back, until the front one has not. Frames moved in the same
+// pass keep their list order rather than their exact order of use.
+class LruPolicy : public ReplacementPolicy {
+public:
+    const char *name() const override { return "lru"; }
+    void reset(uint32_t frames, const FrameAccess *a) override {
+        order.reset(frames);
+        filed.assign(frames, 0);
+        access = a;
+    }
+    void on_load(int frame) override {
+        filed[frame] = access[frame].last.load(std::memory_order_relaxed);
+        order.push_back(frame);
+    }
+    void on_remove(int frame) override { order.remove(frame); }
+    int peek_victim() override {
+        // one pass moves every frame used since it was filed; accesses
+        // racing it can only keep it going a little longer
+        for (size_t tries = 0; tries <= order.size(); ++tries) {
+            int f = order.front();
+            if (f == -1) return -1;
+            uint64_t last = access[f].last.load(std::memory_order_relaxed);
+            if (last == filed[f]) return f;
+            filed[f] = last;
+            order.remove(f);
+            order.push_back(f);
+        }
+        return order.front();
+    }
+
+private:
+    FrameList order;
+    std::vector<uint64_t> filed;   // access clock each frame is filed at
+    const FrameAccess *access = nullptr;
+};
+
+// CLOCK / second chance: frames sit on a circular list. A frame counts as
+// referenced if it was accessed since the hand last passed it (or was just
+// loaded); the hand clears that as it passes and evicts the first frame
+// that is not referenced.
+class ClockPolicy : public ReplacementPolicy {
+public:
+    const char *name() const override { return "clock"; }
+    void reset(uint32_t frames, const FrameAccess *a) override {
+        ring.reset(frames);
+        seen.assign(frames, 0);
+        access = a;
+        hand = -1;
+    }
+    void on_load(int frame) override {
+        ring.push_back(frame);
+        seen[frame] = LOADED;
+        if (hand == -1) hand = frame;
+    }
+    void on_remove(int frame) override {
+        if (!ring.contains(frame)) return;
+        if (hand == frame) hand = advance(frame);
+        ring.remove(frame);
+        if (ring.empty()) hand = -1;
+    }
+    int peek_victim() override {
+        if (ring.empty()) return -1;
+        // one full turn clears every reference; accesses racing the hand
+        // can only keep it going a little longer
+        for (size_t tries = 0; tries <= 2 * ring.size(); ++tries) {
+            uint64_t count = access[hand].count.load(std::memory_order_relaxed);
+            if (count == seen[hand]) break;
+            seen[hand] = count;
+            hand = advance(hand);
+        }
+        return hand;
+    }
+
+private:
+    static constexpr uint64_t LOADED = UINT64_MAX;   // referenced by being loaded
+
+    int advance(int f) const {
+        int n = ring.next(f);
+        return (n == -1) ? ring.front() : n;
+    }
+
+    FrameList ring;
+    std::vector<uint64_t> seen;   // access count when the hand last passed
+    const FrameAccess *access = nullptr;
+    int hand = -1;
+};
+
+// Least frequently used, with ties broken FIFO. Frames are grouped into
+// buckets by the access count they were filed at, in ascending order, and
+// loaded frames start at 0. Counts only grow, so a frame at the front of the
+// first bucket whose count has not passed the bucket's is the least used;
+// one whose has moves up to the bucket for the next count and is looked at
+// again when it gets to the front.
+class LfuPolicy : public ReplacementPolicy {
+public:
+    const char *name() const override { return "lfu"; }
+    void reset(uint32_t frames, const FrameAccess *a) override {
+        buckets.clear();
+        where.assign(frames, Position());
+        access = a;
+    }
+    void on_load(int frame) override {
+        if (where[frame].tracked) return;
+        auto b = buckets.begin();
+        if (b == buckets.end() || b->count != 0) b = buckets.insert(b, Bucket{0, {}});
+        place(frame, b);
+    }
+    void on_remove(int frame) override {
+        if (where[frame].tracked) unplace(frame);
+    }
+    int peek_victim() override {
+        // each move up is paid for by an access, and counts are finite
+        while (!buckets.empty()) {
+            auto b = buckets.begin();
+            int f = b->frames.front();
+            if (access[f].count.load(std::memory_order_relaxed) <= b->count) return f;
+            auto nb = std::next(b);
+            if (nb == buckets.end() || nb->count != b->count + 1)
+                nb = buckets.insert(nb, Bucket{b->count + 1, {}});
+            unplace(f);
+            place(f, nb);
+        }
+        return -1;
+    }
+
+private:
+    struct Bucket {
+        uint64_t count;
+        std::list<int> frames;
+    };
+    struct Position {
+        bool tracked = false;
+        std::list<Bucket>::iterator bucket;
+        std::list<int>::iterator entry;
+    };
+
+    void place(int frame, std::list<Bucket>::iterator b) {
+        b->frames.push_back(frame);
+        where[frame].tracked = true;
+        where[frame].bucket = b;
+        where[frame].entry = std::prev(b->frames.end());
+    }
+    void unplace(int frame) {
+        auto b = where[frame].bucket;
+        b->frames.erase(where[frame].entry);
+        where[frame].tracked = false;
+        if (b->frames.empty()) buckets.erase(b);
+    }
+
+    std::list<Bucket> buckets;
+    std::vector<Position> where;
+    const FrameAccess *access = nullptr;
+};
+
+inline bool is_replacement_policy_name(const std::string &name) {
+    return name == "fifo" || name == "lru" || name == "clock" || name == "lfu";
+}
+
+// Policy names accepted by make_replacement_policy; stats are indexed in this order
+inline const char *const REPLACEMENT_POLICY_NAMES[] = {"fifo", "lru", "clock", "lfu"};
+
+inline int replacement_policy_index(const std::string &name) {
+    for (int i = 0; i < 4; ++i)
+        if (name == REPLACEMENT_POLICY_NAMES[i]) return i;
+    return 0;
+}
+
+// Unknown names fall back to FIFO
+inline std::unique_ptr<ReplacementPolicy> make_replacement_policy(const std::string &name) {
+    if (name == "lru") return std::make_unique<LruPolicy>();
+    if (name == "clock") return std::make_unique<ClockPolicy>();
+    if (name == "lfu") return std::make_unique<LfuPolicy>();
+    return std::make_unique<FifoPolicy>();
+}
+
+#endif
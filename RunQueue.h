@@ -0,0 +1,222 @@
+#ifndef RUN_QUEUE_H
+#define RUN_QUEUE_H
+
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <algorithm>
+#include <cstdint>
+#include "process.h"
+
+// Ready processes, one queue per core plus a global injection queue for new
+// processes. A core serves its own queue, then the injection queue, then
+// steals half of the longest queue of another core, so dispatch only touches
+// a shared lock when its own queue runs dry. Each queue has its own mutex;
+// dispatch never holds two at once.
+//
+// Each queue is a heap ordered by the priority the scheduling policy gave a
+// process when it was queued (lower first), then by arrival, so equal
+// priorities are served FIFO. Together the queues form a relaxed concurrent
+// priority queue: a core takes the best of its own queue, the injection
+// queue and one other queue picked at random, comparing their heads through
+// lock-free hints, and steals the best half of a victim's queue.
+//
+// A queued process has assigned_core == -1. pop() claims the process for the
+// core (assigned_core = core) under the queue lock, so holding lock_all()
+// keeps every queued process where it is.
+class RunQueues {
+public:
+    using Proc = std::shared_ptr<ProcessStub>;
+
+    explicit RunQueues(int cores) : local(cores) {}
+
+    int cores() const { return (int)local.size(); }
+
+    // Processes waiting in any queue
+    size_t size() const { return queued.load(); }
+
+    // A core's own queue (preempted or requeued processes)
+    void push_local(int core, const Proc &p, uint64_t prio) { push(local[core], p, prio); }
+
+    // New processes; picked up by whichever core runs dry first
+    void inject(const Proc &p, uint64_t prio) { push(global, p, prio); }
+
+    // Next process for core, or nullptr if every queue is empty. from, if
+    // given, is set to the queue it came from: a core, or -1 for the
+    // injection queue.
+    Proc pop(int core, int *from = nullptr) {
+        int src;
+        Proc p = pop_any(core, src);
+        if (from) *from = src;
+        return p;
+    }
+
+    // Put p back on the queue pop() reported it came from
+    void push_back_to(int from, const Proc &p, uint64_t prio) {
+        if (from < 0) inject(p, prio);
+        else push_local(from, p, prio);
+    }
+
+    // Process on each core (guarded by that core's queue lock)
+    void set_current(int core, const Proc &p) {
+        std::lock_guard<std::mutex> lk(local[core].m);
+        local[core].current = p;
+    }
+
+    // Locks every queue, in core order, then the injection queue
+    std::vector<std::unique_lock<std::mutex>> lock_all() {
+        std::vector<std::unique_lock<std::mutex>> locks;
+        locks.reserve(local.size() + 1);
+        for (auto &q : local) locks.emplace_back(q.m);
+        locks.emplace_back(global.m);
+        return locks;
+    }
+
+    const Proc &current_locked(int core) const { return local[core].current; }
+
+    // Give every queued process the priority f returns for it, keeping the
+    // order among equal priorities
+    template <typename F>
+    void refile(F f) {
+        auto locks = lock_all();
+        for (auto &q : local) refile_locked(q, f);
+        refile_locked(global, f);
+    }
+
+    std::vector<Proc> current() {
+        auto locks = lock_all();
+        std::vector<Proc> out;
+        for (auto &q : local) out.push_back(q.current);
+        return out;
+    }
+
+private:
+    static constexpr unsigned GLOBAL_CHECK_INTERVAL = 61;
+    static constexpr uint64_t EMPTY = UINT64_MAX;   // top of an empty queue
+
+    struct Entry {
+        uint64_t prio;
+        uint64_t seq;   // arrival order within the queue
+        Proc p;
+
+        // heap order: the best entry (lowest prio, then oldest) on top
+        bool operator<(const Entry &o) const { return prio != o.prio ? prio > o.prio : seq > o.seq; }
+    };
+
+    struct alignas(64) Queue {
+        std::mutex m;
+        std::vector<Entry> heap;
+        uint64_t next_seq = 0;
+        std::atomic<size_t> len{0};           // heap.size(), readable without the lock
+        std::atomic<uint64_t> top{EMPTY};     // priority of the head
+        Proc current;                         // per-core queues only
+        unsigned dispatches = 0;              // touched by the owning core only
+        uint64_t rng = 0;                     // likewise
+
+        void add_locked(const Proc &p, uint64_t prio) {
+            heap.push_back(Entry{prio, next_seq++, p});
+            std::push_heap(heap.begin(), heap.end());
+        }
+
+        Entry take_locked() {
+            std::pop_heap(heap.begin(), heap.end());
+            Entry e = std::move(heap.back());
+            heap.pop_back();
+            return e;
+        }
+
+        void changed_locked() {
+            len.store(heap.size(), std::memory_order_relaxed);
+            top.store(heap.empty() ? EMPTY : heap.front().prio, std::memory_order_relaxed);
+        }
+    };
+
+    void push(Queue &q, const Proc &p, uint64_t prio) {
+        std::lock_guard<std::mutex> lk(q.m);
+        p->assigned_core.store(-1);
+        q.add_locked(p, std::min(prio, EMPTY - 1));
+        q.changed_locked();
+        queued.fetch_add(1);
+    }
+
+    Proc pop_front(Queue &q, int core) {
+        if (q.len.load(std::memory_order_relaxed) == 0) return nullptr;
+        std::lock_guard<std::mutex> lk(q.m);
+        if (q.heap.empty()) return nullptr;
+        Proc p = q.take_locked().p;
+        q.changed_locked();
+        queued.fetch_sub(1);
+        p->assigned_core.store(core);
+        return p;
+    }
+
+    Proc pop_any(int core, int &src) {
+        Queue &own = local[core];
+        // the injection queue goes first if its head is better, and now and
+        // then on a tie so new processes are not starved by a core that
+        // always has local work
+        uint64_t po = own.top.load(std::memory_order_relaxed);
+        uint64_t pg = global.top.load(std::memory_order_relaxed);
+        Queue *best = &own;
+        if (pg < po || (++own.dispatches % GLOBAL_CHECK_INTERVAL == 0 && pg == po)) best = &global;
+        // a random other queue, in case it holds something better still
+        if (local.size() > 1) {
+            own.rng = own.rng * 6364136223846793005ULL + 1442695040888963407ULL;
+            Queue &other = local[(core + 1 + (own.rng >> 33) % (local.size() - 1)) % local.size()];
+            if (other.top.load(std::memory_order_relaxed) < best->top.load(std::memory_order_relaxed)) best = &other;
+        }
+        src = best == &global ? -1 : (int)(best - local.data());
+        if (Proc p = pop_front(*best, core)) return p;
+        src = core;
+        if (Proc p = pop_front(own, core)) return p;
+        src = -1;
+        if (Proc p = pop_front(global, core)) return p;
+        return steal(core, src);
+    }
+
+    template <typename F>
+    void refile_locked(Queue &q, F &f) {
+        for (auto &e : q.heap) e.prio = std::min<uint64_t>(f(*e.p), EMPTY - 1);
+        std::make_heap(q.heap.begin(), q.heap.end());
+        q.changed_locked();
+    }
+
+    // Take the best half of the longest other queue: run the first of them,
+    // keep the rest locally
+    Proc steal(int core, int &src) {
+        int victim = -1;
+        size_t most = 0;
+        for (int i = 0; i < (int)local.size(); ++i) {
+            size_t n = local[i].len.load(std::memory_order_relaxed);
+            if (i != core && n > most) { most = n; victim = i; }
+        }
+        if (victim < 0) return nullptr;
+        src = victim;
+
+        std::vector<Entry> taken;
+        {
+            Queue &v = local[victim];
+            std::lock_guard<std::mutex> lk(v.m);
+            if (v.heap.empty()) return nullptr;
+            size_t n = (v.heap.size() + 1) / 2;
+            for (size_t i = 0; i < n; ++i) taken.push_back(v.take_locked());
+            v.changed_locked();
+            queued.fetch_sub(1);
+            taken.front().p->assigned_core.store(core);
+        }
+        if (taken.size() > 1) {
+            Queue &own = local[core];
+            std::lock_guard<std::mutex> lk(own.m);
+            for (auto it = taken.begin() + 1; it != taken.end(); ++it) own.add_locked(it->p, it->prio);
+            own.changed_locked();
+        }
+        return taken.front().p;
+    }
+
+    std::vector<Queue> local;
+    Queue global;
+    std::atomic<size_t> queued{0};
+};
+
+#endif
@@ -0,0 +1,157 @@
+#ifndef SCHEDULING_POLICY_H
+#define SCHEDULING_POLICY_H
+
+#include <cstdint>
+#include <vector>
+#include <string>
+#include <memory>
+#include <atomic>
+#include <algorithm>
+#include "process.h"
+#include "config.h"
+
+// CPU scheduling policy. The scheduler asks it how long a process may run
+// per turn and tells it how much of that turn was used before the process
+// goes back into a run queue; the policy gives the priority the process
+// waits at there (lower runs first, equal ones in FIFO order). Policies keep their
+// per-process state in ProcessStub's sched_* fields, which are only touched
+// by whoever holds the process: the core running it, or the run queues.
+// Slices count instructions, or clock ticks on virtual time.
+class SchedulingPolicy {
+public:
+    virtual ~SchedulingPolicy() = default;
+    virtual const char *name() const = 0;   // as shown in process logs
+
+    // How long p may run this turn; 0 runs it until it finishes or sleeps
+    virtual uint32_t time_slice(ProcessStub &p) = 0;
+
+    // Run queue priority of p, taken whenever it is queued
+    virtual uint64_t priority(ProcessStub &) { return 0; }
+
+    // p ran for `used` of its turn and is about to be queued again
+    // (preempted, or going to sleep)
+    virtual void on_requeue(ProcessStub &, uint32_t) {}
+
+    // Periodic work every period() ms (clock ticks on virtual time), 0 for
+    // none. When due(now), every queued process is passed to refile() and
+    // queued again at its new priority.
+    virtual uint64_t period() const { return 0; }
+    virtual bool due(uint64_t) { return false; }
+    virtual void refile(ProcessStub &) {}
+};
+
+// First-come first-served: one queue, no preemption.
+class FcfsPolicy : public SchedulingPolicy {
+public:
+    const char *name() const override { return "FCFS"; }
+    uint32_t time_slice(ProcessStub &) override { return 0; }
+};
+
+// Round robin: one queue, quantum-cycles per turn.
+class RoundRobinPolicy : public SchedulingPolicy {
+public:
+    explicit RoundRobinPolicy(uint32_t quantum) : quantum(std::max<uint32_t>(quantum, 1)) {}
+    const char *name() const override { return "RR"; }
+    uint32_t time_slice(ProcessStub &) override { return quantum; }
+
+private:
+    uint32_t quantum;
+};
+
+// Multi-level feedback queue. New processes start at level 0. A process
+// that has used up the allotment of its level (the level's quantum, summed
+// over turns so sleeping just before it runs out does not reset it) moves
+// one level down. Every boost period all processes go back to level 0, so
+// long-running ones are not starved and can climb back after a change of
+// behaviour.
+class MlfqPolicy : public SchedulingPolicy {
+public:
+    MlfqPolicy(std::vector<uint32_t> quanta, uint64_t boost_period)
+        : quanta(std::move(quanta)), boost_period(boost_period), next_boost(boost_period) {}
+
+    const char *name() const override { return "MLFQ"; }
+    int levels() const { return (int)quanta.size(); }
+
+    // The level is the priority
+    uint64_t priority(ProcessStub &p) override {
+        catch_up(p);
+        return (uint64_t)p.sched_level;
+    }
+
+    // What is left of the level's allotment
+    uint32_t time_slice(ProcessStub &p) override {
+        catch_up(p);
+        uint32_t q = quanta[p.sched_level];
+        return p.sched_used < q ? q - p.sched_used : 1;
+    }
+
+    void on_requeue(ProcessStub &p, uint32_t used) override {
+        catch_up(p);
+        p.sched_used += used;
+        if (p.sched_used >= quanta[p.sched_level]) {
+            if (p.sched_level + 1 < levels()) p.sched_level++;
+            p.sched_used = 0;
+        }
+    }
+
+    uint64_t period() const override { return boost_period; }
+
+    bool due(uint64_t now) override {
+        uint64_t next = next_boost.load();
+        if (now < next || !next_boost.compare_exchange_strong(next, now + boost_period)) return false;
+        epoch.fetch_add(1);
+        return true;
+    }
+
+    void refile(ProcessStub &p) override { catch_up(p); }
+
+private:
+    // A boost since p last looked resets it to the top level
+    void catch_up(ProcessStub &p) {
+        uint64_t e = epoch.load();
+        if (p.sched_epoch == e) return;
+        p.sched_epoch = e;
+        p.sched_level = 0;
+        p.sched_used = 0;
+    }
+
+    std::vector<uint32_t> quanta;   // per level, level 0 first
+    uint64_t boost_period;
+    std::atomic<uint64_t> next_boost;
+    std::atomic<uint64_t> epoch{0};
+};
+
+// Shortest job first: no preemption; the queued process with the fewest
+// instructions left runs next.
+class SjfPolicy : public SchedulingPolicy {
+public:
+    const char *name() const override { return "SJF"; }
+    uint32_t time_slice(ProcessStub &) override { return 0; }
+    uint64_t priority(ProcessStub &p) override {
+        int left = p.total_instructions - p.current_instruction.load();
+        return left > 0 ? (uint64_t)left : 0;
+    }
+};
+
+// Shortest remaining time first: SJF, but the running process is preempted
+// every quantum-cycles and queued again by what it has left, so a shorter
+// arrival takes over at the next quantum boundary.
+class SrtfPolicy : public SjfPolicy {
+public:
+    explicit SrtfPolicy(uint32_t quantum) : quantum(std::max<uint32_t>(quantum, 1)) {}
+    const char *name() const override { return "SRTF"; }
+    uint32_t time_slice(ProcessStub &) override { return quantum; }
+
+private:
+    uint32_t quantum;
+};
+
+inline std::unique_ptr<SchedulingPolicy> make_scheduling_policy(const Config &cfg) {
+    if (cfg.scheduler == "fcfs") return std::make_unique<FcfsPolicy>();
+    if (cfg.scheduler == "sjf") return std::make_unique<SjfPolicy>();
+    if (cfg.scheduler == "srtf") return std::make_unique<SrtfPolicy>(cfg.quantum_cycles);
+    if (cfg.scheduler == "mlfq") return std::make_unique<MlfqPolicy>(cfg.mlfq_quanta, cfg.mlfq_boost);
+    return std::make_unique<RoundRobinPolicy>(cfg.quantum_cycles);
+}
+
+#endif
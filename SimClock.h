@@ -0,0 +1,136 @@
+#ifndef SIM_CLOCK_H
+#define SIM_CLOCK_H
+
+#include <cstdint>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+
+// Virtual CPU clock for simulation mode. Time is counted in ticks and only
+// moves when every participant (core threads, batch generator) is blocked
+// on the clock: it then jumps straight to the earliest wake-up tick. Time a
+// thread spends computing takes no simulated time, so runs go as fast as
+// the host allows, and idle stretches cost nothing.
+class SimClock {
+public:
+    void reset(int participants) {
+        std::lock_guard<std::mutex> lk(m);
+        state.assign(participants, RUNNING);
+        deadline.assign(participants, 0);
+        woken.assign(participants, false);
+        now_ = 0;
+        work_gen = 0;
+        stopped = false;
+    }
+
+    uint64_t now() const {
+        std::lock_guard<std::mutex> lk(m);
+        return now_;
+    }
+
+    // Block participant id until tick t, or until wake(id). Returns false
+    // once stopped.
+    bool sleep_until(int id, uint64_t t) {
+        std::unique_lock<std::mutex> lk(m);
+        if (stopped) return false;
+        if (consume_wake_locked(id) || t <= now_) return true;
+        state[id] = WAITING;
+        deadline[id] = t;
+        advance_locked();
+        cv.wait(lk, [&] { return stopped || state[id] == RUNNING; });
+        state[id] = RUNNING;
+        consume_wake_locked(id);
+        return !stopped;
+    }
+
+    bool sleep_for(int id, uint64_t ticks) {
+        return sleep_until(id, now() + ticks);
+    }
+
+    // Snapshot to pass to wait_for_work, taken before looking for work
+    uint64_t work_seen() const {
+        std::lock_guard<std::mutex> lk(m);
+        return work_gen;
+    }
+
+    // Block participant id until notify_work() is called after `seen` was
+    // taken, or until wake(id); the clock may run on meanwhile. Returns the
+    // ticks that passed, or -1 once stopped.
+    int64_t wait_for_work(int id, uint64_t seen) {
+        std::unique_lock<std::mutex> lk(m);
+        if (stopped) return -1;
+        if (consume_wake_locked(id) || work_gen != seen) return 0;
+        uint64_t since = now_;
+        state[id] = IDLE;
+        advance_locked();
+        cv.wait(lk, [&] { return stopped || state[id] == RUNNING; });
+        state[id] = RUNNING;
+        consume_wake_locked(id);
+        return stopped ? -1 : (int64_t)(now_ - since);
+    }
+
+    // New work is available: idle participants run again before the clock
+    // moves on
+    void notify_work() {
+        std::lock_guard<std::mutex> lk(m);
+        ++work_gen;
+        bool woke = false;
+        for (auto &s : state) {
+            if (s == IDLE) { s = RUNNING; woke = true; }
+        }
+        if (woke) cv.notify_all();
+    }
+
+    // Cut participant id's current (or next) wait short, before the clock
+    // moves on; for a participant whose wake-up time has changed
+    void wake(int id) {
+        std::lock_guard<std::mutex> lk(m);
+        woken[id] = true;
+        if (state[id] != RUNNING) {
+            state[id] = RUNNING;
+            cv.notify_all();
+        }
+    }
+
+    void stop() {
+        std::lock_guard<std::mutex> lk(m);
+        stopped = true;
+        cv.notify_all();
+    }
+
+private:
+    enum State : uint8_t { RUNNING, WAITING, IDLE };
+
+    bool consume_wake_locked(int id) {
+        bool w = woken[id];
+        woken[id] = false;
+        return w;
+    }
+
+    // Once nobody is running, jump to the earliest deadline and release
+    // everyone due by then
+    void advance_locked() {
+        uint64_t next = UINT64_MAX;
+        for (size_t i = 0; i < state.size(); ++i) {
+            if (state[i] == RUNNING) return;
+            if (state[i] == WAITING && deadline[i] < next) next = deadline[i];
+        }
+        if (next == UINT64_MAX) return;   // all idle: wait for work
+        now_ = next;
+        for (size_t i = 0; i < state.size(); ++i) {
+            if (state[i] == WAITING && deadline[i] <= now_) state[i] = RUNNING;
+        }
+        cv.notify_all();
+    }
+
+    mutable std::mutex m;
+    std::condition_variable cv;
+    std::vector<State> state;
+    std::vector<uint64_t> deadline;
+    std::vector<bool> woken;
+    uint64_t now_ = 0;
+    uint64_t work_gen = 0;
+    bool stopped = false;
+};
+
+#endif
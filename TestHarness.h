@@ -0,0 +1,42 @@
+#ifndef TEST_HARNESS_H
+#define TEST_HARNESS_H
+
+#include <iostream>
+#include <vector>
+
+// Unit test support for the *_test.cpp files, which tests.cpp links into one
+// binary. TEST(name) defines a test and registers it; CHECK(cond) reports a
+// failed condition and lets the test carry on.
+
+struct TestCase {
+    const char *file;
+    const char *name;
+    void (*run)();
+};
+
+inline std::vector<TestCase> &test_cases() {
+    static std::vector<TestCase> cases;
+    return cases;
+}
+
+inline int test_failures = 0;
+
+struct TestRegistration {
+    TestRegistration(const char *file, const char *name, void (*run)()) {
+        test_cases().push_back(TestCase{file, name, run});
+    }
+};
+
+#define TEST(name) \
+    static void name(); \
+    static TestRegistration name##_registration(__FILE__, #name, name); \
+    static void name()
+
+#define CHECK(cond) do { \
+    if (!(cond)) { \
+        std::cout << __FILE__ << ":" << __LINE__ << ": FAIL " #cond "\n"; \
+        ++test_failures; \
+    } \
+} while (0)
+
+#endif
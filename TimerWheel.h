@@ -0,0 +1,117 @@
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <utility>
+
+// Hierarchical timer wheel. Level l has 64 slots of 64^l ticks each, so four
+// levels cover 2^24 ticks ahead; later timers wait in the last level and are
+// re-filed as it turns. Adding a timer is O(1), and advancing a tick only
+// touches one level-0 slot, plus one slot of each higher level every time
+// the level below wraps around (cascading its timers down). Not thread-safe.
+template <typename T>
+class TimerWheel {
+public:
+    static constexpr int LEVELS = 4;
+    static constexpr int SLOT_BITS = 6;
+    static constexpr int SLOTS = 1 << SLOT_BITS;
+
+    // Start empty at tick now
+    void reset(uint64_t now) {
+        for (auto &level : wheel)
+            for (auto &slot : level) slot.clear();
+        cur = now;
+        count = 0;
+    }
+
+    uint64_t now() const { return cur; }
+    size_t size() const { return count; }
+
+    // Fire item at tick expires (already due: on the next advance)
+    void add(T item, uint64_t expires) {
+        if (expires <= cur) expires = cur + 1;
+        file(Timer{std::move(item), expires});
+        ++count;
+    }
+
+    // Move the wheel to tick now, appending expired items to out in
+    // expiry order
+    void advance(uint64_t now, std::vector<T> &out) {
+        while (cur < now) {
+            if (count == 0) { cur = now; break; }
+            ++cur;
+            // lower levels wrapped around: refile the next slot of each
+            // level above them, highest first
+            int top = 0;
+            while (top + 1 < LEVELS && (cur & (((uint64_t)1 << (SLOT_BITS * (top + 1))) - 1)) == 0) ++top;
+            for (int l = top; l >= 1; --l) {
+                auto moved = std::move(wheel[l][slot_of(cur, l)]);
+                wheel[l][slot_of(cur, l)].clear();
+                for (auto &t : moved) file(std::move(t));
+            }
+            auto &slot = wheel[0][slot_of(cur, 0)];
+            for (size_t i = 0; i < slot.size(); ) {
+                if (slot[i].expires <= cur) {
+                    out.push_back(std::move(slot[i].item));
+                    slot[i] = std::move(slot.back());
+                    slot.pop_back();
+                    --count;
+                } else {
+                    ++i;
+                }
+            }
+        }
+    }
+
+    // A tick no later than the earliest timer (UINT64_MAX if empty); the
+    // caller can sleep until then and advance. Timers above level 0 count
+    // from the start of their slot, when they are cascaded down.
+    uint64_t next_expiry() const {
+        if (count == 0) return UINT64_MAX;
+        uint64_t best = UINT64_MAX;
+        for (int l = 0; l < LEVELS; ++l) {
+            for (int i = 1; i <= SLOTS; ++i) {
+                uint64_t t = ((cur >> (SLOT_BITS * l)) + i) << (SLOT_BITS * l);
+                if (t >= best) break;
+                if (!wheel[l][slot_of(t, l)].empty()) { best = t; break; }
+            }
+        }
+        return best;
+    }
+
+    // Remove every timer, due or not
+    void drain(std::vector<T> &out) {
+        for (auto &level : wheel)
+            for (auto &slot : level) {
+                for (auto &t : slot) out.push_back(std::move(t.item));
+                slot.clear();
+            }
+        count = 0;
+    }
+
+private:
+    struct Timer {
+        T item;
+        uint64_t expires;
+    };
+
+    static int slot_of(uint64_t t, int level) {
+        return (int)((t >> (SLOT_BITS * level)) & (SLOTS - 1));
+    }
+
+    // Level of a timer: the lowest one whose range still reaches its expiry
+    void file(Timer t) {
+        uint64_t delta = t.expires - cur;
+        int l = 0;
+        while (l < LEVELS - 1 && delta >= ((uint64_t)SLOTS << (SLOT_BITS * l))) ++l;
+        wheel[l][slot_of(t.expires, l)].push_back(std::move(t));
+    }
+
+    std::vector<Timer> wheel[LEVELS][SLOTS];
+    uint64_t cur = 0;
+    size_t count = 0;
+};
+
+#endif
@@ -0,0 +1,69 @@
+#ifndef WORKING_SET_H
+#define WORKING_SET_H
+
+#include <atomic>
+#include <bitset>
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+// Pages a process has used recently: its working set over the last few turns
+// on a core. The memory manager marks each page as it is touched; at the end
+// of a turn the core that ran the process folds those marks into a window of
+// the last `window` turns. A page counts if it was touched in any of them.
+class WorkingSet {
+public:
+    // Track a process of `pages` pages, with nothing touched yet
+    void reset(int pages) {
+        words = pages > 0 ? ((size_t)pages + 63) / 64 : 0;
+        touched.reset(words ? new std::atomic<uint64_t>[words]() : nullptr);
+        history.clear();
+        next = 0;
+        count.store(0);
+    }
+
+    // Page used during the current turn (any core, lock-free)
+    void touch(uint32_t page) {
+        size_t w = page / 64;
+        if (w >= words) return;
+        uint64_t bit = (uint64_t)1 << (page % 64);
+        if (!(touched[w].load(std::memory_order_relaxed) & bit))
+            touched[w].fetch_or(bit, std::memory_order_relaxed);
+    }
+
+    // Close a turn: it replaces the oldest of the last `window` turns.
+    // Returns the working set size in pages. Only called by the core
+    // holding the process.
+    size_t end_turn(unsigned window) {
+        if (window == 0 || words == 0) return 0;
+        if (history.size() != window) {
+            history.assign(window, std::vector<uint64_t>(words, 0));
+            next = 0;
+        }
+        std::vector<uint64_t> &slot = history[next];
+        next = (next + 1) % window;
+        for (size_t i = 0; i < words; ++i) slot[i] = touched[i].exchange(0, std::memory_order_relaxed);
+
+        size_t n = 0;
+        for (size_t i = 0; i < words; ++i) {
+            uint64_t any = 0;
+            for (auto &turn : history) any |= turn[i];
+            n += std::bitset<64>(any).count();
+        }
+        count.store(n);
+        return n;
+    }
+
+    // Working set size as of the last end_turn
+    size_t size() const { return count.load(); }
+
+private:
+    size_t words = 0;
+    std::unique_ptr<std::atomic<uint64_t>[]> touched;
+    std::vector<std::vector<uint64_t>> history;   // one bitmap per turn, ring
+    unsigned next = 0;                            // oldest turn in history
+    std::atomic<size_t> count{0};
+};
+
+#endif
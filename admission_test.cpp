@@ -0,0 +1,132 @@
+// Admission control: working set charges against the frame budget,
+// deferral and reservation, yielding, and the page fault frequency
+// feedback.
+#include <memory>
+#include "AdmissionControl.h"
+#include "TestHarness.h"
+using namespace std;
+
+static unique_ptr<ProcessStub> process(int id, int pages = 16) {
+    auto p = make_unique<ProcessStub>();
+    p->id = id;
+    p->num_pages = pages;
+    p->working_set.reset(pages);
+    return p;
+}
+
+// One turn on a core touching pages [0, ws)
+static void turn(AdmissionControl &ac, ProcessStub &p, uint32_t ws, uint64_t faults = 0, uint64_t instructions = 100) {
+    for (uint32_t i = 0; i < ws; ++i) p.working_set.touch(i);
+    ac.end_turn(p, faults, instructions);
+}
+
+TEST(disabled_admits_everything) {
+    AdmissionControl off(0, 10, 4), no_memory(2, 10, 0);
+    auto p = process(1, 64);
+    CHECK(!off.enabled() && !no_memory.enabled());
+    for (int i = 0; i < 10; ++i) CHECK(off.admit(*p) && no_memory.admit(*p));
+    CHECK(p->ws_charged == 0);
+}
+
+TEST(charges_follow_the_working_set) {
+    AdmissionControl ac(2, 10, 16);
+    auto p = process(1);
+    CHECK(ac.admit(*p));
+    CHECK(ac.stats().admitted == 1);   // one page until the working set is known
+    CHECK(ac.admit(*p));               // already admitted: no second charge
+    turn(ac, *p, 5);
+    CHECK(p->ws_charged == 5 && ac.stats().admitted == 5);
+    turn(ac, *p, 2);
+    CHECK(ac.stats().admitted == 5);   // still in the window
+    turn(ac, *p, 2);
+    CHECK(ac.stats().admitted == 2);
+    ac.release(*p);
+    CHECK(p->ws_charged == 0 && ac.stats().admitted == 0);
+
+    auto none = process(2, 0);         // no memory: never charged
+    CHECK(ac.admit(*none) && none->ws_charged == 0);
+}
+
+TEST(defers_and_reserves_when_full) {
+    AdmissionControl ac(1, 10, 10);
+    auto a = process(1), b = process(2), c = process(3);
+    CHECK(ac.admit(*a));
+    turn(ac, *a, 8);
+    b->working_set.touch(0);
+    b->working_set.touch(1);
+    b->working_set.touch(2);
+    b->working_set.end_turn(1);        // b needs 3: 8 + 3 > 10
+    CHECK(!ac.admit(*b));
+    CHECK(ac.reserver() == b->id && ac.stats().deferrals == 1);
+    CHECK(!ac.admit(*c));              // 8 + 1 fits, but not next to b's 3
+    CHECK(ac.reserver() == b->id);
+    ac.release(*a);
+    CHECK(ac.admit(*b));
+    CHECK(ac.reserver() == -1);
+    CHECK(ac.admit(*c));
+    CHECK(ac.stats().admitted == 4);
+}
+
+TEST(nothing_admitted_admits_despite_reservation) {
+    AdmissionControl ac(1, 10, 10);
+    auto a = process(1), big = process(2), x = process(3);
+    CHECK(ac.admit(*a));
+    turn(ac, *a, 6);
+    for (uint32_t i = 0; i < 8; ++i) big->working_set.touch(i);
+    big->working_set.end_turn(1);
+    CHECK(!ac.admit(*big));            // reserves 8
+    x->working_set.touch(0);
+    x->working_set.touch(1);
+    x->working_set.touch(2);
+    x->working_set.end_turn(1);
+    CHECK(!ac.admit(*x));
+    ac.release(*a);
+    // x was deferred before the reserver and 3 + 8 > 10, but with nothing
+    // admitted it must get in or nobody would ever run
+    CHECK(ac.admit(*x));
+    CHECK(ac.reserver() == big->id);
+}
+
+TEST(yields_after_resident_windows_or_over_budget) {
+    AdmissionControl ac(2, 1000, 10);
+    auto a = process(1), b = process(2);
+    CHECK(ac.admit(*a));
+    CHECK(!ac.should_yield(*a));
+    turn(ac, *a, 9);
+    for (uint32_t i = 0; i < 4; ++i) b->working_set.touch(i);
+    b->working_set.end_turn(2);
+    CHECK(!ac.admit(*b));              // reserves
+    int turns = 1;
+    while (!ac.should_yield(*a) && turns < 100) {
+        turn(ac, *a, 9);
+        ++turns;
+    }
+    CHECK(turns == 8);                 // RESIDENT_WINDOWS windows of 2 turns
+    ac.release(*a);
+    CHECK(!ac.should_yield(*a));       // not admitted
+    CHECK(ac.admit(*b));
+
+    // grown past the budget: out after one window
+    AdmissionControl ac2(2, 1000, 10);
+    auto c = process(3, 64);
+    CHECK(ac2.admit(*c));
+    turn(ac2, *c, 12);
+    CHECK(!ac2.should_yield(*c));
+    turn(ac2, *c, 12);
+    CHECK(ac2.should_yield(*c));
+}
+
+TEST(fault_frequency_moves_the_budget) {
+    AdmissionControl ac(1, 10, 64);
+    auto p = process(1);
+    CHECK(ac.admit(*p));
+    turn(ac, *p, 4, 1000, 100);        // loading the working set: not counted
+    for (int i = 0; i < 32; ++i) turn(ac, *p, 4, 5, 100);   // 50 per 1000
+    CHECK(ac.stats().pff == 50);
+    CHECK(ac.stats().budget == 56);    // shrinks by an eighth
+    for (int i = 0; i < 32 * 40; ++i) turn(ac, *p, 4, 5, 100);
+    CHECK(ac.stats().budget == 16);    // but not below a quarter
+    for (int i = 0; i < 32 * 40; ++i) turn(ac, *p, 4, 0, 100);
+    CHECK(ac.stats().pff == 0);
+    CHECK(ac.stats().budget == 64);    // grows back up to the frame count
+}
@@ -0,0 +1,121 @@
+// What the process bytecode compiler makes of well-formed and malformed
+// lines.
+#include <string>
+#include <vector>
+#include "Bytecode.h"
+#include "TestHarness.h"
+using namespace std;
+
+static shared_ptr<const Program> compile(const vector<string> &lines) {
+    SymbolTable syms;
+    return compile_program(lines, syms);
+}
+
+static string message(const Program &p, size_t i) {
+    return p.code[i].op == Opcode::BAD ? p.strings[p.code[i].text] : string();
+}
+
+TEST(operands_and_executed_count) {
+    auto p = compile({"DECLARE x 5", "", "ADD y x 70000", "SUB y y 1", "NOSUCH 1", "PRINT \"hi\""});
+    CHECK(p->code.size() == 6);
+    CHECK(p->code[0].op == Opcode::DECLARE && p->code[0].is_var(0) && !p->code[0].is_var(1));
+    CHECK(p->code[0].arg[1] == 5);
+    CHECK(p->code[1].op == Opcode::NOP);
+    CHECK(p->code[2].op == Opcode::ADD && p->code[2].is_var(1) && !p->code[2].is_var(2));
+    CHECK(p->code[2].arg[2] == 65535);   // literals clamp to uint16
+    CHECK(p->code[2].arg[1] == p->code[0].arg[0]);
+    CHECK(p->code[3].arg[0] == p->code[2].arg[0]);
+    CHECK(p->code[4].op == Opcode::SKIP);
+    CHECK(p->strings[p->code[5].text] == "hi");
+    CHECK(p->var_names == vector<string>({"x", "y"}));
+    CHECK(p->executed_total == 6);
+}
+
+TEST(read_and_write_operands) {
+    auto p = compile({"READ x 0x40", "WRITE 0x42 70000", "WRITE 64 x", "READ x", "READ x nowhere"});
+    CHECK(p->code[0].op == Opcode::READ && p->code[0].arg[1] == 0x40 && p->code[0].is_var(0));
+    CHECK(p->strings[p->code[0].text] == "0x40");
+    CHECK(p->code[1].op == Opcode::WRITE && p->code[1].arg[0] == 0x42 && p->code[1].arg[1] == 65535);
+    CHECK(message(*p, 2) == "Invalid WRITE value: x");
+    CHECK(message(*p, 3) == "Malformed READ instruction");
+    CHECK(message(*p, 4) == "Invalid READ address: nowhere");
+}
+
+TEST(malformed_lines_compile_to_bad) {
+    auto p = compile({"DECLARE x", "ADD x 1", "SUB", "WRITE 0x40"});
+    CHECK(message(*p, 0) == "Malformed DECLARE instruction");
+    CHECK(message(*p, 1) == "Malformed ADD instruction");
+    CHECK(message(*p, 2) == "Malformed SUB instruction");
+    CHECK(message(*p, 3) == "Malformed WRITE instruction");
+    CHECK(p->executed_total == 4);   // still take their turn
+}
+
+TEST(variables_bind_symbol_slots) {
+    auto q = compile({"DECLARE x 5", "ADD y x 1"});
+    CHECK(q->var_slots == vector<int>({0, 1}));
+
+    SymbolTable syms;
+    syms.bind("pre");
+    vector<string> lines;
+    for (int i = 0; i < SymbolTable::SLOTS + 2; ++i) lines.push_back("DECLARE v" + to_string(i) + " 1");
+    auto p = compile_program(lines, syms);
+    CHECK(p->var_slots[0] == 1);   // slot 0 was taken before
+    CHECK(p->var_slots[SymbolTable::SLOTS - 2] == SymbolTable::SLOTS - 1);
+    CHECK(p->var_slots[SymbolTable::SLOTS - 1] == -1);   // table full
+    CHECK(syms.names.size() == (size_t)SymbolTable::SLOTS);
+}
+
+TEST(for_matches_its_end) {
+    auto p = compile({"FOR 3", "PRINT a", "END"});
+    CHECK(p->code[0].op == Opcode::FOR && p->code[0].arg[0] == 3 && p->code[0].arg[1] == 2);
+    CHECK(p->code[2].op == Opcode::END && p->code[2].arg[0] == 0);
+    CHECK(p->executed_total == 1 + 3);
+}
+
+TEST(for_nests) {
+    auto p = compile({"FOR 2", "FOR 3", "FOR 4", "PRINT a", "END", "END", "END"});
+    CHECK(p->code[2].arg[1] == 4 && p->code[1].arg[1] == 5 && p->code[0].arg[1] == 6);
+    CHECK(p->code[4].arg[0] == 2 && p->code[5].arg[0] == 1 && p->code[6].arg[0] == 0);
+    CHECK(p->executed_total == 1 + 2 + 6 + 24);
+}
+
+// one level too deep: that FOR is rejected, its body runs inline and
+// its END is dropped, so the outer ENDs still match
+TEST(for_beyond_max_depth_is_rejected) {
+    auto p = compile({"FOR 2", "FOR 2", "FOR 2", "FOR 5", "PRINT a", "END", "END", "END", "END"});
+    CHECK(p->code[3].op == Opcode::BAD);
+    CHECK(message(*p, 3) == "FOR nested deeper than " + to_string(FOR_MAX_DEPTH) + " levels");
+    CHECK(p->code[5].op == Opcode::NOP);
+    CHECK(p->code[6].op == Opcode::END && p->code[6].arg[0] == 2);
+    CHECK(p->code[8].op == Opcode::END && p->code[8].arg[0] == 0);
+    CHECK(p->executed_total == 1 + 2 + 4 + 8 + 8 + 8);   // the dropped END is a NOP
+}
+
+// unmatched END; unclosed FOR points at itself and its body runs once
+TEST(unmatched_end_and_unclosed_for) {
+    auto p = compile({"END", "FOR 4", "PRINT a"});
+    CHECK(message(*p, 0) == "END without FOR");
+    CHECK(p->code[1].op == Opcode::FOR && p->code[1].arg[1] == 1);
+    CHECK(p->executed_total == 3);
+}
+
+TEST(for_counts) {
+    auto p = compile({"FOR 0", "PRINT a", "END", "FOR x", "END"});
+    CHECK(p->executed_total == 1 + 0 + 1);
+    CHECK(p->code[3].arg[0] == 1);   // unparsable count: once
+}
+
+TEST(copy_and_fill_operands) {
+    auto p = compile({"COPY 0x40 0 8", "COPY 1 2", "COPY a 2 3", "COPY 1 2 -",
+                      "FILL 0x40 300 4", "FILL 0 1", "FILL 0 x 2", "FILL 0 0x7f 0x10"});
+    CHECK(p->code[0].op == Opcode::COPY);
+    CHECK(p->code[0].arg[0] == 0x40 && p->code[0].arg[1] == 0 && p->code[0].arg[2] == 8);
+    CHECK(p->strings[p->code[0].text] == "0x40" && p->strings[p->code[0].text + 1] == "0");
+    CHECK(message(*p, 1) == "Malformed COPY instruction");
+    CHECK(message(*p, 2) == "Invalid COPY operands");
+    CHECK(message(*p, 3) == "Invalid COPY operands");
+    CHECK(p->code[4].op == Opcode::FILL && p->code[4].arg[1] == 255);   // byte clamps
+    CHECK(message(*p, 5) == "Malformed FILL instruction");
+    CHECK(message(*p, 6) == "Invalid FILL operands");
+    CHECK(p->code[7].op == Opcode::FILL && p->code[7].arg[1] == 0x7f && p->code[7].arg[2] == 16);
+}
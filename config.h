@@ -7,12 +7,16 @@
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <vector>
+#include <algorithm>
+
+#include "ReplacementPolicy.h"
 
 using namespace std;
 
 struct Config {
     int num_cpu = 1;                    //[1,128]
-    string scheduler = "rr";            //"fcfs" or "rr"
+    string scheduler = "rr";            //"fcfs", "rr", "mlfq", "sjf" or "srtf"
     uint32_t quantum_cycles = 5;        //[1, 2^32-1]
     uint32_t batch_process_freq = 1;    //[1, 2^32-1]
     uint32_t min_ins = 1;               //[1, 2^32-1]
@@ -22,6 +26,16 @@ struct Config {
     uint32_t mem_per_frame = 256;       //[2^6, 2^16] power of 2 format
     uint32_t min_mem_per_proc = 256;    //[2^6, 2^16] power of 2 format
     uint32_t max_mem_per_proc = 4096;   //[2^6, 2^16] power of 2 format
+    string page_replacement = "fifo";   //"fifo", "lru", "clock" or "lfu"
+    uint32_t free_frames_low = 5;       //[0, 100] % of frames; 0 disables background page-out
+    uint32_t free_frames_high = 10;     //[free-frames-low, 100] % of frames
+    uint32_t read_ahead = 2;            //[0, 2^32-1] pages loaded ahead of a sequential fault; 0 disables
+    bool virtual_time = false;          //0 or 1: delays, SLEEP, quantum and batch frequency in simulated ticks
+    int mlfq_levels = 3;                //[1, 8]
+    vector<uint32_t> mlfq_quanta = {2, 4, 8};  //per level, top first; levels past the list double the last quantum
+    uint32_t mlfq_boost = 1000;         //[0, 2^32-1] ms (ticks on virtual time) between priority boosts; 0 disables
+    uint32_t ws_window = 4;             //[0, 64] quanta of working set history for admission control; 0 disables
+    uint32_t pff_target = 100;          //[0, 2^32-1] page faults per 1000 instructions the admission budget aims under
 };
 
 static inline bool clamp_int(int &v, int lo, int hi) {
@@ -34,6 +48,7 @@ static inline optional<string> load_config_from_file(const string &path, Config
     ifstream ifs(path);
     if (!ifs) return optional<string>("file-not-found");
     
+    bool mlfq_levels_set = false;
     string line;
     while (getline(ifs, line)) {
         // Trim whitespace
@@ -74,7 +89,7 @@ static inline optional<string> load_config_from_file(const string &path, Config
                 //Normalize to lowercase
                 for (auto &c : val) c = tolower(c);
                 
-                if (val == "fcfs" || val == "rr") {
+                if (val == "fcfs" || val == "rr" || val == "mlfq" || val == "sjf" || val == "srtf") {
                     out.scheduler = val;
                 } else {
                     return optional<string>("invalid-scheduler");
@@ -120,6 +135,60 @@ static inline optional<string> load_config_from_file(const string &path, Config
                 uint32_t v = static_cast<uint32_t>(stoul(val));
                 out.max_mem_per_proc = v;
             }
+            else if (key == "page-replacement") {
+                for (auto &c : val) c = tolower(c);
+                if (is_replacement_policy_name(val)) {
+                    out.page_replacement = val;
+                } else {
+                    return optional<string>("invalid-page-replacement");
+                }
+            }
+            else if (key == "free-frames-low") {
+                uint32_t v = static_cast<uint32_t>(stoul(val));
+                if (v > 100) v = 100;
+                out.free_frames_low = v;
+            }
+            else if (key == "free-frames-high") {
+                uint32_t v = static_cast<uint32_t>(stoul(val));
+                if (v > 100) v = 100;
+                out.free_frames_high = v;
+            }
+            else if (key == "read-ahead") {
+                uint32_t v = static_cast<uint32_t>(stoul(val));
+                out.read_ahead = v;
+            }
+            else if (key == "virtual-time") {
+                out.virtual_time = stoul(val) != 0;
+            }
+            else if (key == "mlfq-levels") {
+                int v = stoi(val);
+                if (v < 1) v = 1;
+                if (v > 8) v = 8;
+                out.mlfq_levels = v;
+                mlfq_levels_set = true;
+            }
+            else if (key == "mlfq-quanta") {
+                // list of quanta, quoted or not: mlfq-quanta "2 4 8"
+                string list = s.substr(key.size());
+                replace(list.begin(), list.end(), '"', ' ');
+                istringstream qs(list);
+                vector<uint32_t> q;
+                uint32_t v;
+                while (q.size() < 8 && qs >> v) q.push_back(v < 1 ? 1 : v);
+                if (q.empty()) return optional<string>("invalid-mlfq-quanta");
+                out.mlfq_quanta = q;
+            }
+            else if (key == "mlfq-boost") {
+                out.mlfq_boost = static_cast<uint32_t>(stoul(val));
+            }
+            else if (key == "ws-window") {
+                uint32_t v = static_cast<uint32_t>(stoul(val));
+                if (v > 64) v = 64;
+                out.ws_window = v;
+            }
+            else if (key == "pff-target") {
+                out.pff_target = static_cast<uint32_t>(stoul(val));
+            }
         } catch (...) {
             return optional<string>("parse-error");
         }
@@ -127,6 +196,16 @@ static inline optional<string> load_config_from_file(const string &path, Config
     
     //Ensure max_ins >= min_ins
     if (out.max_ins < out.min_ins) out.max_ins = out.min_ins;
+
+    //One quantum per MLFQ level (as many levels as quanta unless given);
+    //levels without one get twice the one above
+    if (!mlfq_levels_set) out.mlfq_levels = (int)out.mlfq_quanta.size();
+    while ((int)out.mlfq_quanta.size() < out.mlfq_levels)
+        out.mlfq_quanta.push_back(out.mlfq_quanta.back() * 2);
+    out.mlfq_quanta.resize(out.mlfq_levels);
+
+    //Ensure free_frames_high >= free_frames_low
+    if (out.free_frames_high < out.free_frames_low) out.free_frames_high = out.free_frames_low;
     
     return nullopt;  //Success (no error)
 }
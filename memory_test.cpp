@@ -0,0 +1,202 @@
+// Demand paging through MemoryManager: faulting pages in, evicting them to
+// the backing store and back under every replacement policy, bulk access
+// across pages, whole-process swapping, and cores racing on a full memory
+// with the page-out daemon running.
+#include <atomic>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include "MemoryManager.h"
+#include "TestHarness.h"
+using namespace std;
+
+// Counters MemoryManager reports to; the emulator defines them in osemulator.cpp
+atomic<uint64_t> num_paged_in{0};
+atomic<uint64_t> num_paged_out{0};
+atomic<uint64_t> tlb_hits{0};
+atomic<uint64_t> tlb_misses{0};
+atomic<uint64_t> num_background_page_outs{0};
+atomic<uint64_t> num_direct_reclaims{0};
+atomic<uint64_t> num_prefetched{0};
+atomic<uint64_t> prefetch_hits{0};
+atomic<uint64_t> prefetch_wasted{0};
+atomic<uint64_t> num_swap_outs{0};
+atomic<uint64_t> num_swap_ins{0};
+atomic<uint64_t> swap_out_bytes{0};
+atomic<uint64_t> swap_in_bytes{0};
+atomic<uint64_t> num_zero_pages{0};
+
+static const uint32_t FRAME = 64;
+
+static shared_ptr<ProcessStub> process(MemoryManager &mm, int id, uint32_t bytes) {
+    auto p = make_shared<ProcessStub>();
+    p->id = id;
+    p->name = "p" + to_string(id);
+    p->memory_required = bytes;
+    CHECK(mm.allocate_process(p, bytes));
+    return p;
+}
+
+// A value for every 16-bit word of a process, distinct across processes
+static uint16_t pattern(int id, uint32_t addr) { return (uint16_t)(id * 7919 + addr * 31); }
+
+static void write_all(MemoryManager &mm, const shared_ptr<ProcessStub> &p) {
+    for (uint32_t a = 0; a < p->memory_required; a += 2) CHECK(mm.write_u16(p, a, pattern(p->id, a)));
+}
+
+static bool reads_back(MemoryManager &mm, const shared_ptr<ProcessStub> &p) {
+    for (uint32_t a = 0; a < p->memory_required; a += 2) {
+        uint16_t v = 0;
+        if (!mm.read_u16(p, a, v) || v != pattern(p->id, a)) return false;
+    }
+    return true;
+}
+
+TEST(pages_fault_in_on_first_use) {
+    MemoryManager mm;
+    mm.init(16 * FRAME, FRAME, "fifo");
+    auto p = process(mm, 1, 8 * FRAME);
+    uint16_t v = 1;
+    CHECK(mm.read_u16(p, 3 * FRAME, v) && v == 0);   // untouched: a zero page
+    CHECK(!mm.read_u16(p, 8 * FRAME, v));            // outside its memory
+    CHECK(!mm.write_u16(p, 8 * FRAME - 1, 1));       // straddles the end
+    write_all(mm, p);
+    CHECK(reads_back(mm, p));
+    CHECK(p->page_faults.load() == 8);                // once per page, fits in memory
+    mm.free_process(p);
+}
+
+TEST(evicted_pages_come_back_under_every_policy) {
+    for (const char *policy : REPLACEMENT_POLICY_NAMES) {
+        MemoryManager mm;
+        mm.init(16 * FRAME, FRAME, policy);
+        CHECK(string(mm.replacement_policy_name()) == policy);
+        auto a = process(mm, 1, 16 * FRAME), b = process(mm, 2, 16 * FRAME);
+        uint64_t out_before = num_paged_out.load();
+        write_all(mm, a);
+        write_all(mm, b);   // needs every frame: a goes to the backing store
+        CHECK(num_paged_out.load() - out_before >= 16);
+        CHECK(reads_back(mm, a));
+        CHECK(reads_back(mm, b));
+        auto s = mm.paging_stats();
+        CHECK(s.evictions[replacement_policy_index(policy)] >= 32);
+        mm.free_process(a);
+        mm.free_process(b);
+    }
+}
+
+TEST(zero_and_compressible_pages_round_trip) {
+    MemoryManager mm;
+    mm.init(4 * FRAME, FRAME, "lru");
+    auto a = process(mm, 1, 8 * FRAME), b = process(mm, 2, 8 * FRAME);
+    CHECK(mm.write_u16(a, 0, 0x1234));               // page 0: mostly zeros
+    CHECK(mm.fill(a, FRAME, 0, FRAME));              // page 1: all zeros
+    CHECK(mm.fill(a, 2 * FRAME, 0xAB, FRAME));       // page 2: one run
+    write_all(mm, b);                                // push a out
+    uint16_t v = 0;
+    CHECK(mm.read_u16(a, 0, v) && v == 0x1234);
+    CHECK(mm.read_u16(a, 2, v) && v == 0);
+    CHECK(mm.read_u16(a, FRAME + 10, v) && v == 0);
+    CHECK(mm.read_u16(a, 2 * FRAME + 62, v) && v == 0xABAB);
+    CHECK(reads_back(mm, b));
+    auto bs = mm.backing_store_stats();
+    CHECK(bs.zero_pages == 1);                       // page 1 only
+    CHECK(bs.packed_pages >= 2);                     // pages 0 and 2
+    CHECK(mm.write_u16(a, FRAME, 7));
+    CHECK(reads_back(mm, b));                        // push a out again
+    CHECK(mm.backing_store_stats().zero_pages == 0);
+    CHECK(mm.read_u16(a, FRAME, v) && v == 7);
+    mm.free_process(a);
+    mm.free_process(b);
+    CHECK(mm.backing_store_stats().packed_pages == 0);
+}
+
+TEST(bulk_access_crosses_pages) {
+    MemoryManager mm;
+    mm.init(4 * FRAME, FRAME, "clock");
+    auto p = process(mm, 1, 16 * FRAME);   // more pages than frames
+    vector<uint8_t> data(5 * FRAME + 7), back(data.size());
+    for (size_t i = 0; i < data.size(); ++i) data[i] = (uint8_t)(i * 13 + 1);
+    CHECK(mm.write_bytes(p, FRAME - 3, data.data(), data.size()));
+    CHECK(mm.fill(p, 10 * FRAME + 5, 0x5A, 3 * FRAME));
+    CHECK(mm.read_bytes(p, FRAME - 3, back.data(), back.size()));
+    CHECK(back == data);
+    vector<uint8_t> filled(3 * FRAME);
+    CHECK(mm.read_bytes(p, 10 * FRAME + 5, filled.data(), filled.size()));
+    CHECK(filled == vector<uint8_t>(3 * FRAME, 0x5A));
+    CHECK(!mm.read_bytes(p, 16 * FRAME - 4, back.data(), 5));   // runs off the end
+    CHECK(!mm.write_bytes(p, 0xFFFFFFF0u, data.data(), 32));    // wraps around
+    mm.free_process(p);
+}
+
+TEST(swap_out_and_in_keep_contents) {
+    MemoryManager mm;
+    mm.init(16 * FRAME, FRAME, "fifo");
+    auto a = process(mm, 1, 8 * FRAME), b = process(mm, 2, 8 * FRAME);
+    write_all(mm, a);
+    write_all(mm, b);
+    size_t out = mm.swap_out_process(a);
+    CHECK(a->swapped_out.load());
+    CHECK(out == 8 * FRAME);
+    CHECK(mm.swap_out_process(a) == 0);               // already out
+    // a's frames are free again: c fits without evicting b
+    auto c = process(mm, 3, 8 * FRAME);
+    uint64_t out_before = num_paged_out.load();
+    write_all(mm, c);
+    CHECK(num_paged_out.load() == out_before);
+    mm.free_process(c);
+    CHECK(mm.swap_in_process(a) == 8 * FRAME);
+    CHECK(!a->swapped_out.load());
+    uint64_t faults = a->page_faults.load();
+    CHECK(reads_back(mm, a));
+    CHECK(a->page_faults.load() == faults);           // all resident again
+    CHECK(reads_back(mm, b));
+    mm.free_process(a);
+    mm.free_process(b);
+}
+
+// Cores faulting, evicting and writing concurrently, each on its own
+// process, while the page-out daemon and read-ahead run: nothing may be
+// lost or mixed up between processes
+TEST(concurrent_cores_keep_their_data) {
+    const int CORES = 4;
+    const uint32_t PAGES = 24;
+    MemoryManager mm;
+    mm.init(16 * FRAME, FRAME, "lru");
+    mm.start_page_out_daemon(10, 25);
+    mm.set_read_ahead(2);
+    vector<shared_ptr<ProcessStub>> procs;
+    for (int i = 0; i < CORES; ++i) procs.push_back(process(mm, i + 1, PAGES * FRAME));
+    atomic<int> bad{0}, ready{0};
+    vector<thread> cores;
+    for (int i = 0; i < CORES; ++i) {
+        cores.emplace_back([&, i] {
+            auto &p = procs[i];
+            vector<uint16_t> shadow(PAGES * FRAME / 2, 0);
+            mt19937 rng(i);
+            ++ready;
+            while (ready.load() < CORES) this_thread::yield();
+            for (int n = 0; n < 50000; ++n) {
+                uint32_t w = rng() % shadow.size();
+                if (rng() % 3 == 0) {
+                    uint16_t v = (uint16_t)rng();
+                    if (!mm.write_u16(p, w * 2, v)) ++bad;
+                    shadow[w] = v;
+                } else {
+                    uint16_t v;
+                    if (!mm.read_u16(p, w * 2, v) || v != shadow[w]) ++bad;
+                }
+            }
+            for (uint32_t w = 0; w < shadow.size(); ++w) {
+                uint16_t v;
+                if (!mm.read_u16(p, w * 2, v) || v != shadow[w]) ++bad;
+            }
+        });
+    }
+    for (auto &t : cores) t.join();
+    mm.stop_page_out_daemon();
+    CHECK(bad.load() == 0);
+    for (auto &p : procs) mm.free_process(p);
+}
@@ -34,6 +34,18 @@ std::atomic<uint64_t> active_ticks{0};
 std::atomic<uint64_t> total_ticks{0};
 std::atomic<uint64_t> num_paged_in{0};
 std::atomic<uint64_t> num_paged_out{0};
+std::atomic<uint64_t> tlb_hits{0};
+std::atomic<uint64_t> tlb_misses{0};
+std::atomic<uint64_t> num_background_page_outs{0};
+std::atomic<uint64_t> num_direct_reclaims{0};
+std::atomic<uint64_t> num_prefetched{0};
+std::atomic<uint64_t> prefetch_hits{0};
+std::atomic<uint64_t> prefetch_wasted{0};
+std::atomic<uint64_t> num_swap_outs{0};
+std::atomic<uint64_t> num_swap_ins{0};
+std::atomic<uint64_t> swap_out_bytes{0};
+std::atomic<uint64_t> swap_in_bytes{0};
+std::atomic<uint64_t> num_zero_pages{0};
 
 //ProcessStub and repository helpers are provided in process.h
 
@@ -98,6 +110,11 @@ static void print_summary(ostream &out) {
         }
     }
     
+    // Waiting (time in run queues) and turnaround (submission to finish)
+    // of processes that went through the scheduler
+    const char *unit = global_config.virtual_time ? " ticks" : " ms";
+    uint64_t total_wait = 0, total_turnaround = 0, timed = 0;
+
     out << "\nFinished Processes:" << endl;
     for (auto &kv : processes) {
         auto &p = kv.second;
@@ -106,10 +123,24 @@ static void print_summary(ostream &out) {
                 << p->created_timestamp << ")\t"
                 << "Memory: " << p->memory_required << " bytes\t"
                 << "Finished\t"
-                << p->total_instructions << " / " << p->total_instructions
-                << endl;
+                << p->total_instructions << " / " << p->total_instructions;
+            uint64_t arrival = p->arrival_time.load(), finish = p->finish_time.load();
+            if (p->arrived.load() && finish >= arrival) {
+                uint64_t wait = p->wait_time.load();
+                out << "\tWaiting: " << wait << unit
+                    << "\tTurnaround: " << (finish - arrival) << unit;
+                total_wait += wait;
+                total_turnaround += finish - arrival;
+                timed++;
+            }
+            out << endl;
         }
     }
+    if (timed > 0) {
+        out << "\nScheduler (" << global_config.scheduler << ") over " << timed << " finished processes:" << endl;
+        out << "  Average waiting time   : " << (double)total_wait / timed << unit << endl;
+        out << "  Average turnaround time: " << (double)total_turnaround / timed << unit << endl;
+    }
     out << "---------------------------------------------------" << endl;
 }
 
@@ -130,6 +161,7 @@ static void print_process(const  shared_ptr<ProcessStub>& p) {
     CustomProcessLines cpl;
     cout << "\nProcess name: " << p->name <<  endl;
     cout << "ID: " << p->id <<  endl;
+    cout << "Page Faults: " << p->page_faults.load() << endl;
     cout << "Logs: " <<  endl;
     {
         lock_guard< mutex> plk(p->mtx);
@@ -146,6 +178,27 @@ static void print_process(const  shared_ptr<ProcessStub>& p) {
     cout << endl;
 }
 
+// Give back a process's pages and its share of used_memory (a swapped-out
+// process has already given that back)
+static void release_process_memory(const shared_ptr<ProcessStub>& p) {
+    bool charged = !p->swapped_out.load();
+    if (mem_manager) mem_manager->free_process(p);
+    if (charged) {
+        used_memory -= p->memory_required;
+        free_memory += p->memory_required;
+    }
+}
+
+// Undo a process that could not be given its memory: nothing of it stays
+// behind, not even its name. Only for processes the failed command created.
+static void discard_process(const shared_ptr<ProcessStub>& p) {
+    if (mem_manager) mem_manager->free_process(p);
+    p->memory_required = 0;
+    lock_guard<mutex> lk(repository_mutex);
+    auto it = processes.find(p->name);
+    if (it != processes.end() && it->second == p) processes.erase(it);
+}
+
 //Run process interactive screen
 static void run_process_screen(const string& process_name) {
     shared_ptr<ProcessStub> p;
@@ -164,6 +217,15 @@ static void run_process_screen(const string& process_name) {
         return;
     }
 
+    // Attaching brings a swapped-out process back into memory; it stays in
+    // while attached (make_room passes over attached processes)
+    p->attached.store(true);
+    if (p->swapped_out.load() && !(scheduler && scheduler->swap_in(p))) {
+        p->attached.store(false);
+        cout << "Process " << process_name << " is swapped out and there is no memory to bring it back yet. Try again later." << endl;
+        return;
+    }
+
     clear_console();
     print_process(p);
 
@@ -215,20 +277,25 @@ static void run_process_screen(const string& process_name) {
             try {
                 int val = stoi(val_str);
 
+                int slot;
                 {
                     lock_guard<mutex> lk(p->mtx);
                     // symbol table limit: 32 variables
-                    if (p->vars.size() >= 32) {
-                        cout << "Symbol table full (32 variables). Declaration ignored.\n";
-                    } else {
-                        p->vars[var] = static_cast<uint16_t>(max(0, min(65535, val)));
-                        add_log(p, "Declared " + var + " = " + to_string(val));
-                        ostringstream linebuf;
-                        linebuf << "DECLARE:        uint16_t " << var << " = " << val << ";";
+                    slot = p->symbols.bind(var);
+                }
+                if (slot < 0) {
+                    cout << "Symbol table full (32 variables). Declaration ignored.\n";
+                } else {
+                    store_symbol(p, slot, static_cast<uint16_t>(max(0, min(65535, val))));
+                    add_log(p, "Declared " + var + " = " + to_string(val));
+                    ostringstream linebuf;
+                    linebuf << "DECLARE:        uint16_t " << var << " = " << val << ";";
+                    {
+                        lock_guard<mutex> lk(p->mtx);
                         p->code.lines.push_back(linebuf.str());
                         p->total_instructions = static_cast<int>(p->code.lines.size());
-                        cout << "Variable '" << var << "' = " << val << " declared successfully." << endl;
                     }
+                    cout << "Variable '" << var << "' = " << val << " declared successfully." << endl;
                 }
             }
             catch (const exception &e) {
@@ -279,30 +346,30 @@ static void run_process_screen(const string& process_name) {
                 add_log(p, string("Memory access violation at ") + addrstr);
 
                 // reclaim memory
-                mem_manager->free_process(p);
-                used_memory -= p->memory_required;
-                free_memory += p->memory_required;
+                release_process_memory(p);
 
                 cout << "Process " << p->name << " shut down due to memory access violation.\n";
                 break;
             }
 
+            int slot;
             {
                 lock_guard<mutex> lk(p->mtx);
-                // store only if table has space
-                if (p->vars.size() < 32) {
-                    p->vars[var] = val;
-                } else {
-                    cout << "[Warning] Symbol table full (32 variables). Value not stored, but read will display.\n";
-                }
+                slot = p->symbols.bind(var);
+            }
+            // store only if table has space
+            if (slot >= 0) {
+                store_symbol(p, slot, val);
+            } else {
+                cout << "[Warning] Symbol table full (32 variables). Value not stored, but read will display.\n";
+            }
 
-                add_log(p, string("READ: ") + var + " <- " + to_string(val));
+            add_log(p, string("READ: ") + var + " <- " + to_string(val));
 
-                // always print
-                cout << var << " = " << val << endl;
-                cout.flush();
-                fflush(stdout);
-            }
+            // always print
+            cout << var << " = " << val << endl;
+            cout.flush();
+            fflush(stdout);
         } else if (cmd == "write") {
             // usage: write <hexaddress> <value>
             string addrstr, valstr;
@@ -320,9 +387,7 @@ static void run_process_screen(const string& process_name) {
                 cout << "Memory access violation at " << addrstr << endl;
                 p->finished.store(true);
                 add_log(p, string("Memory access violation at ") + addrstr);
-                mem_manager->free_process(p);
-                used_memory -= p->memory_required;
-                free_memory += p->memory_required;
+                release_process_memory(p);
                 cout << "Process " << p->name << " shut down due to memory access violation error at " << timestamp_now() << ". " << addrstr << " invalid." << endl;
                 break;
             }
@@ -385,6 +450,10 @@ static void run_process_screen(const string& process_name) {
                 continue;
             }
 
+            auto bind = [&](const string &s) {
+                lock_guard<mutex> lk(p->mtx);
+                return p->symbols.bind(s);
+            };
             auto get_val = [&](const string &s) -> uint16_t {
                 try {
                     int v = stoi(s);
@@ -392,9 +461,7 @@ static void run_process_screen(const string& process_name) {
                     if (v > 65535) return 65535;
                     return static_cast<uint16_t>(v);
                 } catch (...) {
-                    lock_guard<mutex> lk(p->mtx);
-                    if (p->vars.find(s) == p->vars.end()) p->vars[s] = 0;
-                    return p->vars[s];
+                    return load_symbol(p, bind(s));
                 }
             };
 
@@ -404,9 +471,9 @@ static void run_process_screen(const string& process_name) {
                 ? static_cast<uint16_t>(min(65535, (int)v2 + (int)v3))
                 : static_cast<uint16_t>((v2 > v3) ? (v2 - v3) : 0);
 
+            store_symbol(p, bind(var1), result);
             {
                 lock_guard<mutex> lk(p->mtx);
-                p->vars[var1] = result;
                 ostringstream linebuf;
                 linebuf << (cmd=="add"?"ADD":"SUB") << ": "
                         << var1 << " = " << var2 << " "
@@ -429,6 +496,7 @@ static void run_process_screen(const string& process_name) {
             cout << "Unknown command inside screen. Available: process-smi, vmstat, exit, declare, add, sub, print, sleep, for, read, write" << endl;
         }
     }
+    p->attached.store(false);
 
     if (scheduler && !p->finished) {
         scheduler->add_process(p);
@@ -449,12 +517,154 @@ static void vmstat() {
     cout << "  Active  : " << active_ticks.load() << endl;
     cout << "  Total   : " << total_ticks.load() << endl;
 
-    cout << "\nPaging:\n";
+    cout << "\nPaging (" << (mem_manager ? mem_manager->replacement_policy_name() : "fifo") << "):\n";
     cout << "  Paged In : " << num_paged_in.load() << endl;
     cout << "  Paged Out: " << num_paged_out.load() << endl;
+    cout << "  Background Page-Outs: " << num_background_page_outs.load() << endl;
+    cout << "  Direct Reclaims     : " << num_direct_reclaims.load() << endl;
+
+    if (mem_manager) {
+        PagingStats::Snapshot ps = mem_manager->paging_stats();
+        auto avg_us = [](uint64_t ns, uint64_t n) { return n ? ns / 1000.0 / n : 0.0; };
+        cout << fixed << setprecision(2);
+        cout << "\nPage Faults:\n";
+        cout << "  Total     : " << ps.faults[FAULT_FREE_FRAME] + ps.faults[FAULT_EVICTION] << endl;
+        cout << "  Free Frame: " << ps.faults[FAULT_FREE_FRAME] << " (avg "
+             << avg_us(ps.fault_ns[FAULT_FREE_FRAME], ps.faults[FAULT_FREE_FRAME]) << " us)" << endl;
+        cout << "  Eviction  : " << ps.faults[FAULT_EVICTION] << " (avg "
+             << avg_us(ps.fault_ns[FAULT_EVICTION], ps.faults[FAULT_EVICTION]) << " us)" << endl;
+        cout << "  Latency      Free   Eviction\n";
+        for (int b = 0; b < PagingStats::LATENCY_BUCKETS; ++b) {
+            if (!ps.latency[FAULT_FREE_FRAME][b] && !ps.latency[FAULT_EVICTION][b]) continue;
+            uint64_t lim = PagingStats::bucket_limit_us(b);
+            string label = lim ? "<" + to_string(lim) + "us" : ">=" + to_string(PagingStats::bucket_limit_us(b - 1)) + "us";
+            cout << "    " << left << setw(9) << label << right << setw(6) << ps.latency[FAULT_FREE_FRAME][b]
+                 << setw(11) << ps.latency[FAULT_EVICTION][b] << endl;
+        }
+        cout << "  Evictions :";
+        bool any = false;
+        for (int i = 0; i < PagingStats::POLICIES; ++i) {
+            if (!ps.evictions[i]) continue;
+            cout << " " << REPLACEMENT_POLICY_NAMES[i] << "=" << ps.evictions[i];
+            any = true;
+        }
+        cout << (any ? "" : " none") << endl;
+        cout << "  Backing Reads : " << ps.backing_reads << " (avg " << avg_us(ps.backing_read_ns, ps.backing_reads) << " us)" << endl;
+        cout << "  Backing Writes: " << ps.backing_writes << " (avg " << avg_us(ps.backing_write_ns, ps.backing_writes) << " us)" << endl;
+    }
+
+    cout << "\nRead-Ahead (window " << (mem_manager ? mem_manager->read_ahead_window() : 0) << " pages):\n";
+    cout << "  Prefetched: " << num_prefetched.load() << endl;
+    cout << "  Hits      : " << prefetch_hits.load() << endl;
+    cout << "  Wasted    : " << prefetch_wasted.load() << endl;
+
+    cout << "\nSwap:\n";
+    cout << "  Swap-Outs: " << num_swap_outs.load() << " (" << swap_out_bytes.load() << " bytes)" << endl;
+    cout << "  Swap-Ins : " << num_swap_ins.load() << " (" << swap_in_bytes.load() << " bytes)" << endl;
+
+    if (scheduler) {
+        AdmissionControl::Stats ac = scheduler->admission_stats();
+        cout << "\nAdmission Control (" << (ac.frames && global_config.ws_window ? "window " + to_string(global_config.ws_window) + " quanta" : string("off")) << "):\n";
+        cout << "  Budget    : " << ac.budget << " of " << ac.frames << " frames" << endl;
+        cout << "  Admitted  : " << ac.admitted << " pages" << endl;
+        cout << "  Deferrals : " << ac.deferrals << endl;
+        cout << "  Fault Rate: " << ac.pff << " per 1000 instructions (target " << global_config.pff_target << ")" << endl;
+    }
+
+    if (mem_manager) {
+        MemoryManager::BackingStoreStats bs = mem_manager->backing_store_stats();
+        size_t logical = (bs.raw_pages + bs.packed_pages + bs.zero_pages) * (size_t)bs.page_bytes;
+        size_t stored = bs.raw_pages * (size_t)bs.page_bytes + bs.packed_bytes;
+        cout << "\nBacking Store:\n";
+        cout << "  Raw Pages       : " << bs.raw_pages << endl;
+        cout << "  Compressed Pages: " << bs.packed_pages << " (" << bs.packed_bytes << " bytes)" << endl;
+        cout << "  Zero Pages      : " << bs.zero_pages << " (no space)" << endl;
+        cout << "  Stored          : " << stored << " of " << logical << " bytes" << endl;
+        cout << "  Compression     : " << fixed << setprecision(2)
+             << (stored ? (double)logical / stored : 1.0) << "x" << endl;
+    }
+
+    uint64_t hits = tlb_hits.load(), misses = tlb_misses.load();
+    cout << "\nTLB:\n";
+    cout << "  Hits     : " << hits << endl;
+    cout << "  Misses   : " << misses << endl;
+    cout << "  Hit Rate : " << fixed << setprecision(2)
+         << ((hits + misses) ? 100.0 * hits / (hits + misses) : 0.0) << "%" << endl;
     cout << "===================\n";
 }
 
+// Machine-readable counterpart of vmstat: one "key value" pair per line
+// (same layout as config.txt), latencies in nanoseconds.
+static void save_vmstat_dump(const string &path) {
+    ofstream ofs(path);
+    if (!ofs) {
+        cout << "Failed to open " << path << " for writing." << endl;
+        return;
+    }
+    ofs << "total-memory " << total_memory.load() << "\n";
+    ofs << "used-memory " << used_memory.load() << "\n";
+    ofs << "free-memory " << free_memory.load() << "\n";
+    ofs << "idle-ticks " << idle_ticks.load() << "\n";
+    ofs << "active-ticks " << active_ticks.load() << "\n";
+    ofs << "total-ticks " << total_ticks.load() << "\n";
+    ofs << "paged-in " << num_paged_in.load() << "\n";
+    ofs << "paged-out " << num_paged_out.load() << "\n";
+    ofs << "background-page-outs " << num_background_page_outs.load() << "\n";
+    ofs << "direct-reclaims " << num_direct_reclaims.load() << "\n";
+    ofs << "prefetched " << num_prefetched.load() << "\n";
+    ofs << "prefetch-hits " << prefetch_hits.load() << "\n";
+    ofs << "prefetch-wasted " << prefetch_wasted.load() << "\n";
+    ofs << "swap-outs " << num_swap_outs.load() << "\n";
+    ofs << "swap-ins " << num_swap_ins.load() << "\n";
+    ofs << "swap-out-bytes " << swap_out_bytes.load() << "\n";
+    ofs << "swap-in-bytes " << swap_in_bytes.load() << "\n";
+    ofs << "zero-pages " << num_zero_pages.load() << "\n";
+    ofs << "tlb-hits " << tlb_hits.load() << "\n";
+    ofs << "tlb-misses " << tlb_misses.load() << "\n";
+    if (scheduler) {
+        AdmissionControl::Stats ac = scheduler->admission_stats();
+        ofs << "admission-budget " << ac.budget << "\n";
+        ofs << "admitted-pages " << ac.admitted << "\n";
+        ofs << "admission-deferrals " << ac.deferrals << "\n";
+        ofs << "page-fault-rate " << ac.pff << "\n";
+    }
+    if (mem_manager) {
+        ofs << "page-replacement " << mem_manager->replacement_policy_name() << "\n";
+        ofs << "frames " << mem_manager->frame_count() << "\n";
+        ofs << "mem-per-frame " << mem_manager->frame_size() << "\n";
+
+        PagingStats::Snapshot ps = mem_manager->paging_stats();
+        static const char *const path_names[FAULT_PATHS] = {"free-frame", "eviction"};
+        for (int p = 0; p < FAULT_PATHS; ++p) {
+            ofs << "faults." << path_names[p] << " " << ps.faults[p] << "\n";
+            ofs << "fault-ns." << path_names[p] << " " << ps.fault_ns[p] << "\n";
+            for (int b = 0; b < PagingStats::LATENCY_BUCKETS; ++b) {
+                uint64_t lim = PagingStats::bucket_limit_us(b);
+                ofs << "fault-latency." << path_names[p] << "." << (lim ? "lt-" + to_string(lim) + "us" : "inf")
+                    << " " << ps.latency[p][b] << "\n";
+            }
+        }
+        for (int i = 0; i < PagingStats::POLICIES; ++i)
+            ofs << "evictions." << REPLACEMENT_POLICY_NAMES[i] << " " << ps.evictions[i] << "\n";
+        ofs << "backing-reads " << ps.backing_reads << "\n";
+        ofs << "backing-read-ns " << ps.backing_read_ns << "\n";
+        ofs << "backing-writes " << ps.backing_writes << "\n";
+        ofs << "backing-write-ns " << ps.backing_write_ns << "\n";
+
+        MemoryManager::BackingStoreStats bs = mem_manager->backing_store_stats();
+        ofs << "backing-raw-pages " << bs.raw_pages << "\n";
+        ofs << "backing-packed-pages " << bs.packed_pages << "\n";
+        ofs << "backing-packed-bytes " << bs.packed_bytes << "\n";
+        ofs << "backing-zero-pages " << bs.zero_pages << "\n";
+    }
+    {
+        lock_guard<mutex> lk(repository_mutex);
+        for (auto &kv : processes)
+            ofs << "process-faults." << kv.first << " " << kv.second->page_faults.load() << "\n";
+    }
+    cout << "Saved vmstat to " << path << endl;
+}
+
 //Main menu loop
 static void run_main_menu() {
     string command;
@@ -500,6 +710,18 @@ static void run_main_menu() {
                 cout << " mem-per-frame=" << global_config.mem_per_frame <<  endl;
                 cout << " min-mem-per-proc=" << global_config.min_mem_per_proc <<  endl;
                 cout << " max-mem-per-proc=" << global_config.max_mem_per_proc <<  endl;
+                cout << " page-replacement=" << global_config.page_replacement <<  endl;
+                cout << " free-frames-low=" << global_config.free_frames_low <<  endl;
+                cout << " free-frames-high=" << global_config.free_frames_high <<  endl;
+                cout << " read-ahead=" << global_config.read_ahead <<  endl;
+                cout << " virtual-time=" << global_config.virtual_time <<  endl;
+                cout << " ws-window=" << global_config.ws_window <<  endl;
+                cout << " pff-target=" << global_config.pff_target <<  endl;
+                if (global_config.scheduler == "mlfq") {
+                    cout << " mlfq-quanta=";
+                    for (auto q : global_config.mlfq_quanta) cout << q << " ";
+                    cout << "(boost every " << global_config.mlfq_boost << ")" << endl;
+                }
 
                 total_memory.store(global_config.max_overall_mem);
                 free_memory.store(global_config.max_overall_mem);
@@ -507,7 +729,10 @@ static void run_main_menu() {
 
                 // Initialize memory manager
                 mem_manager = std::make_unique<MemoryManager>();
-                mem_manager->init(global_config.max_overall_mem, global_config.mem_per_frame);
+                mem_manager->init(global_config.max_overall_mem, global_config.mem_per_frame,
+                                  global_config.page_replacement);
+                mem_manager->set_read_ahead(global_config.read_ahead);
+                mem_manager->start_page_out_daemon(global_config.free_frames_low, global_config.free_frames_high);
 
                 scheduler = make_unique<Scheduler>(global_config);
                 cout << "Scheduler object created successfully." << endl;
@@ -539,20 +764,28 @@ static void run_main_menu() {
                     continue;
                 }
 
-                auto p = create_process(pname);
-                p->memory_required = mem;
-
                 if (!mem_manager) {
                     cout << "Memory manager not initialized. Run initialize first." << endl;
                     continue;
                 }
+                // a live process of that name keeps its memory untouched
+                auto p = create_new_process(pname);
+                if (!p) {
+                    cout << "Process " << pname << " already exists." << endl;
+                    continue;
+                }
+                p->memory_required = mem;
+
                 if (!mem_manager->allocate_process(p, mem)) {
+                    discard_process(p);
                     cout << "Failed to allocate page table for process." << endl;
                     continue;
                 }
 
-                // Update memory counters
-                if (free_memory.load() < mem) {
+                // Update memory counters, swapping out idle processes if short
+                if (free_memory.load() < mem && !(scheduler && scheduler->make_room(mem, p))) {
+                    // no reservation, so it must not keep pages either
+                    discard_process(p);
                     cout << "Not enough memory available." << endl;
                     continue;
                 }
@@ -610,19 +843,27 @@ static void run_main_menu() {
                     continue;
                 }
 
-                auto p = create_process(pname);
-                p->memory_required = mem;
-
                 if (!mem_manager) {
                     cout << "Memory manager not initialized. Run initialize first." << endl;
                     continue;
                 }
+                // a live process of that name keeps its memory untouched
+                auto p = create_new_process(pname);
+                if (!p) {
+                    cout << "Process " << pname << " already exists." << endl;
+                    continue;
+                }
+                p->memory_required = mem;
+
                 if (!mem_manager->allocate_process(p, mem)) {
+                    discard_process(p);
                     cout << "Failed to allocate page table for process." << endl;
                     continue;
                 }
 
-                if (free_memory.load() < mem) {
+                if (free_memory.load() < mem && !(scheduler && scheduler->make_room(mem, p))) {
+                    // no reservation, so it must not keep pages either
+                    discard_process(p);
                     cout << "Not enough memory available." << endl;
                     continue;
                 }
@@ -677,7 +918,22 @@ static void run_main_menu() {
             continue;
         }
 
-        cout << "Unknown command. Available: initialize, exit, screen, scheduler-start, scheduler-stop, report-util, vmstat" <<  endl;
+        if (root == "vmstat-dump") {
+            save_vmstat_dump("csopesy-vmstat.txt");
+            continue;
+        }
+
+        if (root == "backing-dump") {
+            if (!mem_manager) {
+                cout << "Memory manager not initialized. Run initialize first." << endl;
+                continue;
+            }
+            mem_manager->export_backing_store();
+            cout << "Backing store written to csopesy-backing-store.txt" << endl;
+            continue;
+        }
+
+        cout << "Unknown command. Available: initialize, exit, screen, scheduler-start, scheduler-stop, report-util, vmstat, vmstat-dump, backing-dump" <<  endl;
     }
 }
 
@@ -0,0 +1,77 @@
+// Round trips through the backing store page codec.
+#include <random>
+#include <vector>
+#include "PageCodec.h"
+#include "TestHarness.h"
+using namespace std;
+
+// Packs page into a buffer of cap bytes and unpacks it again. Returns the
+// packed size (0: did not fit).
+static size_t round_trip(const vector<uint8_t> &page, size_t cap) {
+    vector<uint8_t> packed(cap), back(page.size(), 0xAA);
+    size_t len = page_pack(page.data(), page.size(), packed.data(), cap);
+    if (len == 0) return 0;
+    CHECK(len <= cap);
+    CHECK(page_unpack(packed.data(), len, back.data(), back.size()));
+    CHECK(back == page);
+    return len;
+}
+
+TEST(zero_pages) {
+    vector<uint8_t> page(256, 0);
+    CHECK(page_is_zero(page.data(), page.size()));
+    size_t len = round_trip(page, page.size());
+    CHECK(len > 0 && len <= 4);   // two runs of at most 130
+    page[255] = 1;
+    CHECK(!page_is_zero(page.data(), page.size()));
+    page[255] = 0;
+    page[3] = 1;   // inside the first 8-byte word
+    CHECK(!page_is_zero(page.data(), page.size()));
+    CHECK(page_is_zero(page.data(), 3));
+}
+
+TEST(runs_round_trip) {
+    // run lengths around the limits of both codes
+    for (size_t run : {1, 2, 3, 4, 127, 128, 129, 130, 131, 260, 261}) {
+        vector<uint8_t> page;
+        for (int r = 0; r < 3; ++r) page.insert(page.end(), run, (uint8_t)(r + 1));
+        CHECK(round_trip(page, 2 * page.size() + 8) > 0);
+    }
+    // sparse 16-bit values, as the emulator writes them
+    vector<uint8_t> page(1024, 0);
+    for (size_t i = 0; i < page.size(); i += 64) { page[i] = 0x34; page[i + 1] = 0x12; }
+    size_t len = round_trip(page, page.size());
+    CHECK(len > 0 && len < page.size() / 4);
+}
+
+TEST(random_pages_round_trip) {
+    mt19937 rng(7);
+    for (int n = 0; n < 200; ++n) {
+        // few distinct bytes, so there are runs of every length
+        vector<uint8_t> page(64 + rng() % 512);
+        for (auto &b : page) b = (uint8_t)(rng() % 3);
+        CHECK(round_trip(page, 2 * page.size() + 8) > 0);
+    }
+}
+
+TEST(incompressible_page_is_not_packed) {
+    mt19937 rng(11);
+    vector<uint8_t> page(512);
+    for (auto &b : page) b = (uint8_t)rng();
+    for (size_t i = 1; i < page.size(); ++i)
+        if (page[i] == page[i - 1]) page[i] ^= 1;   // no runs at all
+    CHECK(round_trip(page, page.size()) == 0);     // does not pay off
+    CHECK(round_trip(page, page.size() + page.size() / 128 + 1) > 0);
+}
+
+TEST(malformed_input_is_rejected) {
+    uint8_t out[8];
+    const uint8_t short_literal[] = {0x05, 1, 2};        // promises 6 bytes
+    const uint8_t missing_byte[] = {0x81};               // run without its byte
+    const uint8_t too_long[] = {0x87, 0};                // 10 bytes into 8
+    const uint8_t too_short[] = {0x80, 0};               // 3 bytes of 8
+    CHECK(!page_unpack(short_literal, sizeof short_literal, out, sizeof out));
+    CHECK(!page_unpack(missing_byte, sizeof missing_byte, out, sizeof out));
+    CHECK(!page_unpack(too_long, sizeof too_long, out, sizeof out));
+    CHECK(!page_unpack(too_short, sizeof too_short, out, sizeof out));
+}
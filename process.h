@@ -13,6 +13,8 @@
 #include <chrono>
 #include <algorithm>
 #include <functional>
+#include "Bytecode.h"
+#include "WorkingSet.h"
 
 using namespace std;
 
@@ -26,27 +28,93 @@ struct ProcessStub {
     string name;
     int id;
     atomic<bool> finished{false};
-    bool attached{false};
+    atomic<bool> attached{false};   // a screen session is using it
     
     struct LogEntry { 
         string timestamp; 
         string message; 
     };
     vector<LogEntry> logs;
-    map<string, uint16_t> vars;
     CustomProcessLines code;
     mutex mtx;
+
+    // Variable names (guarded by mtx). Values live in the symbol table
+    // segment of the process's memory; a process without memory keeps them
+    // in symbol_values instead.
+    SymbolTable symbols;
+    std::atomic<uint16_t> symbol_values[SymbolTable::SLOTS] = {};
+
+    // code.lines compiled for the scheduler (guarded by mtx; the program
+    // itself is immutable, so a core keeps its own reference while running)
+    shared_ptr<const Program> program;
     
-    // Track instruction execution progress
+    // Track instruction execution progress (instructions executed so far,
+    // counting loop iterations, out of total_instructions)
     atomic<int> current_instruction{0};
     int total_instructions{0};
+
+    // Interpreter state, touched only by the core running the process: the
+    // next instruction and the stack of FOR loops being run
+    struct LoopFrame {
+        int body = 0;        // first instruction of the loop body
+        int remaining = 0;   // iterations left, including the current one
+    };
+    int pc = 0;
+    LoopFrame loops[FOR_MAX_DEPTH];
+    int loop_depth = 0;
+    int sleep_request = 0;   // ticks asked for by SLEEP; the core parks the process
+
+    // Scheduling policy state (see SchedulingPolicy.h): the run queue level
+    // and how much of that level's allotment has been used
+    int sched_level = 0;
+    uint32_t sched_used = 0;
+    uint64_t sched_epoch = 0;
     string created_timestamp;
     atomic<int> assigned_core{-1};  // -1 = not assigned, 0+ = core number
 
     uint32_t memory_required = 0;
 
+    // Page table: frame number per page, -1 if not resident (-2 while the
+    // memory manager is moving the page). Entries are atomic; see MemoryManager.
     int num_pages = 0;
-    std::vector<int> page_table;
+    std::unique_ptr<std::atomic<int>[]> page_table;
+
+    // Software TLB: recently used page -> frame translations, direct-mapped by
+    // page number. Filled and validated by MemoryManager; 0 = empty entry.
+    static constexpr int TLB_ENTRIES = 8;
+    std::atomic<uint64_t> tlb[TLB_ENTRIES] = {};
+
+    // Head of this process's resident frame list (frame number, -1 = none),
+    // linked and guarded by MemoryManager so freeing visits only these frames.
+    int resident_frames = -1;
+    std::atomic<int> frames_evicting{0};   // taken off that list, eviction in progress
+
+    // Set while MemoryManager has the whole process swapped out
+    std::atomic<bool> swapped_out{false};
+
+    // Last page faulted in (or first touched after read-ahead); a fault on
+    // the page right after it counts as sequential and triggers read-ahead.
+    std::atomic<int> last_fault_page{-1};
+
+    // Demand page faults taken by this process (read-ahead loads excluded)
+    std::atomic<uint64_t> page_faults{0};
+
+    // Pages touched over the last few turns (see WorkingSet.h), and the
+    // share of the scheduler's working set budget this process holds while
+    // admitted: pages charged and turns run since admission. The last two
+    // belong to whoever holds the process.
+    WorkingSet working_set;
+    uint32_t ws_charged = 0;
+    uint32_t admitted_turns = 0;
+
+    // Latency accounting, in scheduler time (ms, or ticks on virtual time):
+    // first submission to the scheduler, finish, and total time spent
+    // waiting in run queues. queued_at is set by whoever queues the process.
+    std::atomic<bool> arrived{false};
+    std::atomic<uint64_t> arrival_time{0};
+    std::atomic<uint64_t> finish_time{0};
+    std::atomic<uint64_t> wait_time{0};
+    uint64_t queued_at = 0;
 };
 
 inline map<string, shared_ptr<ProcessStub>> processes;
@@ -87,17 +155,14 @@ inline void add_log(const shared_ptr<ProcessStub> &p, const string &msg, int cor
     p->logs.push_back(std::move(e));
 }
 
-inline shared_ptr<ProcessStub> create_process(const string &name) {
-    lock_guard<mutex> lk(repository_mutex);
-    auto it = processes.find(name);
-    if (it != processes.end()) return it->second;
-    
+// Registers a new process; repository_mutex must be held and name unused
+inline shared_ptr<ProcessStub> make_process_locked(const string &name) {
     int id = ++process_counter;
     auto p = make_shared<ProcessStub>();
     p->name = name;
     p->id = id;
     p->finished.store(false);
-    p->attached = false;
+    p->attached.store(false);
     p->assigned_core.store(-1);
     p->created_timestamp = timestamp_now();
     add_log(p, string("Hello world from ") + p->name + "!");
@@ -105,6 +170,20 @@ inline shared_ptr<ProcessStub> create_process(const string &name) {
     return p;
 }
 
+inline shared_ptr<ProcessStub> create_process(const string &name) {
+    lock_guard<mutex> lk(repository_mutex);
+    auto it = processes.find(name);
+    if (it != processes.end()) return it->second;
+    return make_process_locked(name);
+}
+
+// Like create_process, but nullptr if the name is already taken
+inline shared_ptr<ProcessStub> create_new_process(const string &name) {
+    lock_guard<mutex> lk(repository_mutex);
+    if (processes.count(name)) return nullptr;
+    return make_process_locked(name);
+}
+
 inline string gen_auto_name() {
     int n = process_counter.load() + 1;
     ostringstream ss;
@@ -112,44 +191,52 @@ inline string gen_auto_name() {
     return ss.str();
 }
 
-inline void generate_dummy_instructions(shared_ptr<ProcessStub> p, int num_instructions) {
+// Append one random instruction (i numbers generated variables). A FOR
+// gets a body of 1-3 random instructions, nesting up to FOR_MAX_DEPTH.
+inline void append_dummy_instruction(shared_ptr<ProcessStub> p, int i, int depth) {
     static const vector<string> ops = {"DECLARE", "ADD", "SUBTRACT", "PRINT", "SLEEP", "FOR", "READ", "WRITE"};
+    string op = ops[rand() % ops.size()];
+    if (op == "DECLARE") {
+        string var = "x" + to_string(i);
+        int val = rand() % 100;
+        p->code.lines.push_back("DECLARE " + var + " " + to_string(val));
+    } else if (op == "ADD") {
+        p->code.lines.push_back("ADD x0 x1 " + to_string(rand() % 10));
+    } else if (op == "SUBTRACT") {
+        p->code.lines.push_back("SUBTRACT x0 x1 " + to_string(rand() % 10));
+    } else if (op == "PRINT") {
+        p->code.lines.push_back("PRINT \"Hello world from " + p->name + "!\"");
+    } else if (op == "SLEEP") {
+        p->code.lines.push_back("SLEEP " + to_string(rand() % 200));
+    } else if (op == "FOR" && depth < FOR_MAX_DEPTH) {
+        int repeats = 1 + rand() % 3;
+        int body = 1 + rand() % 3;
+        p->code.lines.push_back("FOR " + to_string(repeats));
+        for (int j = 0; j < body; ++j) append_dummy_instruction(p, i, depth + 1);
+        p->code.lines.push_back("END");
+    } else if (op == "FOR") {
+        p->code.lines.push_back("PRINT \"Hello world from " + p->name + "!\"");
+    } else if (op == "READ") {
+        string var = "read_var_" + to_string(i);
+        uint32_t addr = 0x1000 + (rand() % 0x1000);
+        char buf[32];
+        snprintf(buf, sizeof(buf), "READ %s 0x%x", var.c_str(), addr);
+        p->code.lines.push_back(string(buf));
+    } else if (op == "WRITE") {
+        uint32_t addr = 0x2000 + (rand() % 0x1000);
+        uint16_t val = rand() % 65536;
+        char buf[32];
+        snprintf(buf, sizeof(buf), "WRITE 0x%x %u", addr, val);
+        p->code.lines.push_back(string(buf));
+    }
+}
+
+inline void generate_dummy_instructions(shared_ptr<ProcessStub> p, int num_instructions) {
     p->total_instructions = num_instructions;
     p->current_instruction.store(0);
-    
-    for (int i = 0; i < num_instructions; ++i) {
-        string op = ops[rand() % ops.size()];
-        if (op == "DECLARE") {
-            string var = "x" + to_string(i);
-            int val = rand() % 100;
-            p->code.lines.push_back("DECLARE " + var + " " + to_string(val));
-        } else if (op == "ADD") {
-            p->code.lines.push_back("ADD x0 x1 " + to_string(rand() % 10));
-        } else if (op == "SUBTRACT") {
-            p->code.lines.push_back("SUBTRACT x0 x1 " + to_string(rand() % 10));
-        } else if (op == "PRINT") {
-            p->code.lines.push_back("PRINT \"Hello world from " + p->name + "!\"");
-        } else if (op == "SLEEP") {
-            p->code.lines.push_back("SLEEP " + to_string(rand() % 200));
-        } else if (op == "FOR") {
-            int repeats = 1 + rand() % 3;
-            for (int j = 0; j < repeats; ++j) {
-                p->code.lines.push_back("PRINT \"FOR iteration " + to_string(j+1) + "\"");
-            }
-        } else if (op == "READ") {
-            string var = "read_var_" + to_string(i);
-            uint32_t addr = 0x1000 + (rand() % 0x1000);
-            char buf[32];
-            snprintf(buf, sizeof(buf), "READ %s 0x%x", var.c_str(), addr);
-            p->code.lines.push_back(string(buf));
-        } else if (op == "WRITE") {
-            uint32_t addr = 0x2000 + (rand() % 0x1000);
-            uint16_t val = rand() % 65536;
-            char buf[32];
-            snprintf(buf, sizeof(buf), "WRITE 0x%x %u", addr, val);
-            p->code.lines.push_back(string(buf));
-        }
-    }
+
+    for (int i = 0; i < num_instructions; ++i)
+        append_dummy_instruction(p, i, 0);
 }
 
 #endif
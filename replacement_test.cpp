@@ -0,0 +1,137 @@
+// Victim order of the page replacement policies, driven through the
+// FrameAccess data the memory manager records.
+#include <memory>
+#include <string>
+#include "ReplacementPolicy.h"
+#include "TestHarness.h"
+using namespace std;
+
+static const uint32_t FRAMES = 8;
+static FrameAccess access_data[FRAMES];
+static uint64_t clock_now = 0;
+
+// What MemoryManager does when it fills a frame, and on each access
+static void load(ReplacementPolicy &p, int f) {
+    access_data[f].last.store(++clock_now);
+    access_data[f].count.store(0);
+    p.on_load(f);
+}
+
+static void touch(int f, int times = 1) {
+    for (int i = 0; i < times; ++i) {
+        access_data[f].last.store(++clock_now);
+        access_data[f].count.fetch_add(1);
+    }
+}
+
+static int evict(ReplacementPolicy &p) {
+    int f = p.peek_victim();
+    if (f != -1) p.on_remove(f);
+    return f;
+}
+
+static unique_ptr<ReplacementPolicy> fresh(const string &name) {
+    auto p = make_replacement_policy(name);
+    p->reset(FRAMES, access_data);
+    return p;
+}
+
+TEST(fifo_ignores_accesses) {
+    auto p = fresh("fifo");
+    CHECK(p->peek_victim() == -1);
+    for (int f = 0; f < 4; ++f) load(*p, f);
+    touch(0, 5);
+    CHECK(evict(*p) == 0);
+    CHECK(evict(*p) == 1);
+    load(*p, 0);
+    CHECK(evict(*p) == 2);
+    CHECK(evict(*p) == 3);
+    CHECK(evict(*p) == 0);
+    CHECK(evict(*p) == -1);
+}
+
+TEST(lru_evicts_least_recently_used) {
+    auto p = fresh("lru");
+    for (int f = 0; f < 4; ++f) load(*p, f);
+    touch(0);
+    touch(2);
+    touch(1);
+    // use order now 3, 0, 2, 1
+    CHECK(evict(*p) == 3);
+    CHECK(evict(*p) == 0);
+    touch(0);   // no longer resident: ignored
+    load(*p, 5);
+    touch(2);
+    // 1, 5, 2
+    CHECK(evict(*p) == 1);
+    CHECK(evict(*p) == 5);
+    CHECK(evict(*p) == 2);
+    CHECK(evict(*p) == -1);
+}
+
+TEST(lru_moves_used_frames_back_in_list_order) {
+    auto p = fresh("lru");
+    for (int f = 0; f < 6; ++f) load(*p, f);
+    for (int f = 5; f >= 0; --f) touch(f);
+    // all used since filed: one pass moves each to the back as found
+    for (int f = 0; f < 6; ++f) CHECK(evict(*p) == f);
+
+    for (int f = 0; f < 3; ++f) load(*p, f);
+    touch(0);
+    CHECK(evict(*p) == 1);   // 0 moved behind 2
+    load(*p, 3);
+    CHECK(evict(*p) == 2);
+    CHECK(evict(*p) == 0);
+    CHECK(evict(*p) == 3);
+}
+
+TEST(clock_gives_second_chances) {
+    auto p = fresh("clock");
+    for (int f = 0; f < 4; ++f) load(*p, f);
+    // all referenced by loading: the hand goes round once, clearing them
+    CHECK(evict(*p) == 0);
+    touch(2);
+    // hand at 1 (clear), so 1 goes before the referenced 2
+    CHECK(evict(*p) == 1);
+    CHECK(evict(*p) == 3);   // 2 gets its second chance
+    CHECK(evict(*p) == 2);
+    CHECK(evict(*p) == -1);
+}
+
+TEST(lfu_evicts_least_frequently_used) {
+    auto p = fresh("lfu");
+    for (int f = 0; f < 4; ++f) load(*p, f);
+    touch(0, 3);
+    touch(1, 1);
+    touch(2, 2);
+    touch(3, 1);
+    // counts 3, 1, 2, 1: ties go first-in first-out
+    CHECK(evict(*p) == 1);
+    CHECK(evict(*p) == 3);
+    load(*p, 4);
+    CHECK(evict(*p) == 4);   // never used
+    touch(2, 5);
+    CHECK(evict(*p) == 0);
+    CHECK(evict(*p) == 2);
+    CHECK(evict(*p) == -1);
+}
+
+TEST(lfu_climbs_one_count_at_a_time) {
+    auto p = fresh("lfu");
+    load(*p, 0);
+    load(*p, 1);
+    touch(0, 1000);
+    touch(1, 999);
+    CHECK(evict(*p) == 1);
+    CHECK(evict(*p) == 0);
+}
+
+TEST(replacement_policy_names) {
+    CHECK(string(make_replacement_policy("lru")->name()) == "lru");
+    CHECK(string(make_replacement_policy("bogus")->name()) == "fifo");
+    CHECK(is_replacement_policy_name("clock"));
+    CHECK(!is_replacement_policy_name("mru"));
+    CHECK(replacement_policy_index("lfu") == 3);
+    CHECK(!make_replacement_policy("fifo")->uses_access());
+    CHECK(make_replacement_policy("lru")->uses_access());
+}
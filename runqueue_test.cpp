@@ -0,0 +1,111 @@
+// Per-core run queues: priority and FIFO order, the injection queue,
+// taking work from other cores, refiling, and cores racing on the queues.
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+#include "RunQueue.h"
+#include "TestHarness.h"
+using namespace std;
+
+static shared_ptr<ProcessStub> proc(int id) {
+    auto p = make_shared<ProcessStub>();
+    p->id = id;
+    p->assigned_core.store(-1);
+    return p;
+}
+
+static int pop_id(RunQueues &q, int core, int *from = nullptr) {
+    auto p = q.pop(core, from);
+    return p ? p->id : -1;
+}
+
+TEST(lower_priority_first_then_fifo) {
+    RunQueues q(1);
+    q.push_local(0, proc(1), 5);
+    q.push_local(0, proc(2), 1);
+    q.push_local(0, proc(3), 3);
+    q.push_local(0, proc(4), 1);
+    CHECK(q.size() == 4);
+    CHECK(pop_id(q, 0) == 2);
+    CHECK(pop_id(q, 0) == 4);
+    CHECK(pop_id(q, 0) == 3);
+    auto last = q.pop(0);
+    CHECK(last && last->id == 1 && last->assigned_core.load() == 0);
+    CHECK(q.pop(0) == nullptr && q.size() == 0);
+}
+
+TEST(injected_processes_go_to_any_core) {
+    RunQueues q(2);
+    auto p = proc(1);
+    q.inject(p, 0);
+    CHECK(p->assigned_core.load() == -1);
+    int from = 5;
+    CHECK(pop_id(q, 1, &from) == 1);
+    CHECK(from == -1 && p->assigned_core.load() == 1);
+    q.push_back_to(from, p, 0);
+    CHECK(p->assigned_core.load() == -1);
+    CHECK(pop_id(q, 0, &from) == 1 && from == -1);
+}
+
+TEST(idle_cores_take_work_from_busy_ones) {
+    RunQueues q(3);
+    for (int i = 0; i < 6; ++i) q.push_local(0, proc(i), i);
+    int from = -5;
+    auto p = q.pop(1, &from);
+    CHECK(p && from == 0 && p->assigned_core.load() == 1);
+    CHECK(q.size() == 5);
+    // everything is still handed out exactly once, whichever core asks
+    vector<int> seen{p->id};
+    for (int core = 2; q.size() > 0; core = (core + 1) % 3) {
+        int id = pop_id(q, core);
+        CHECK(id != -1);
+        if (id == -1) break;
+        seen.push_back(id);
+    }
+    sort(seen.begin(), seen.end());
+    CHECK(seen == vector<int>({0, 1, 2, 3, 4, 5}));
+}
+
+TEST(refile_reorders_queued_processes) {
+    RunQueues q(1);
+    for (int i = 0; i < 4; ++i) q.push_local(0, proc(i), i);
+    q.refile([](ProcessStub &p) { return (uint64_t)(10 - p.id); });
+    for (int i = 3; i >= 0; --i) CHECK(pop_id(q, 0) == i);
+}
+
+TEST(concurrent_cores_dispatch_each_process_once) {
+    const int CORES = 4, PROCS = 4000;
+    RunQueues q(CORES);
+    vector<atomic<bool>> requeued(PROCS);
+    vector<atomic<int>> finished(PROCS);
+    atomic<int> done{0}, wrong_core{0};
+    vector<thread> threads;
+    threads.emplace_back([&] {
+        for (int i = 0; i < PROCS; ++i) q.inject(proc(i), i % 7);
+    });
+    for (int c = 0; c < CORES; ++c) {
+        threads.emplace_back([&, c] {
+            while (done.load() < PROCS) {
+                auto p = q.pop(c);
+                if (!p) {
+                    this_thread::yield();
+                    continue;
+                }
+                if (p->assigned_core.load() != c) ++wrong_core;
+                // half the processes get a second turn from this core's queue
+                if (p->id % 2 == 0 && !requeued[p->id].exchange(true)) {
+                    q.push_local(c, p, 3);
+                    continue;
+                }
+                finished[p->id].fetch_add(1);
+                ++done;
+            }
+        });
+    }
+    for (auto &t : threads) t.join();
+    CHECK(wrong_core.load() == 0);
+    CHECK(all_of(finished.begin(), finished.end(), [](const atomic<int> &n) { return n.load() == 1; }));
+    CHECK(q.size() == 0);
+}
@@ -3,15 +3,22 @@
 
 #include <thread>
 #include <queue>
+#include <deque>
 #include <vector>
 #include <mutex>
 #include <atomic>
 #include <condition_variable>
 #include <chrono>
 #include <sstream>
+#include <algorithm>
 #include "process.h"
 #include "config.h"
 #include "MemoryManager.h"
+#include "SimClock.h"
+#include "RunQueue.h"
+#include "TimerWheel.h"
+#include "SchedulingPolicy.h"
+#include "AdmissionControl.h"
 
 extern std::unique_ptr<MemoryManager> mem_manager;
 
@@ -29,42 +36,100 @@ extern atomic<uint64_t> total_ticks;
 extern atomic<uint64_t> num_paged_in;
 extern atomic<uint64_t> num_paged_out;
 
+// Variable access by symbol slot: an indexed uint16 load/store in the
+// process's symbol table segment, with no name lookup or process lock.
+// Slot -1 (symbol table was full) reads as 0 and ignores stores.
+inline uint16_t load_symbol(const shared_ptr<ProcessStub>& p, int slot) {
+    if (slot < 0) return 0;
+    if (p->memory_required == 0 || !mem_manager) return p->symbol_values[slot].load(memory_order_relaxed);
+    uint16_t v = 0;
+    mem_manager->read_u16(p, (uint32_t)slot * sizeof(uint16_t), v);
+    return v;
+}
+
+inline void store_symbol(const shared_ptr<ProcessStub>& p, int slot, uint16_t v) {
+    if (slot < 0) return;
+    if (p->memory_required == 0 || !mem_manager) p->symbol_values[slot].store(v, memory_order_relaxed);
+    else mem_manager->write_u16(p, (uint32_t)slot * sizeof(uint16_t), v);
+}
+
 class Scheduler {
 private:
     Config config;
     atomic<bool> running{false};
     vector<thread> core_threads;
     thread batch_thread;  // Thread for periodic batch process creation
-    queue<shared_ptr<ProcessStub>> ready_queue;
-    mutable mutex mtx;
+    thread timer_thread;  // Wakes sleeping processes
+    unique_ptr<SchedulingPolicy> policy;
+    RunQueues runq;
+
+    // Working set budget: which processes with memory may be dispatched.
+    // Processes it defers wait in `deferred` (oldest first, with the queue
+    // they came from) instead of the run queues; a core defers at most
+    // ADMIT_SCAN of them per dispatch.
+    AdmissionControl admission;
+    static constexpr size_t ADMIT_SCAN = 4;
+    mutex defer_mtx;
+    deque<pair<int, shared_ptr<ProcessStub>>> deferred;
+    atomic<size_t> num_deferred{0};
+
+    // Idle cores park on cv; parked counts them so pushes only take mtx to
+    // wake one when someone is actually waiting
+    mutex mtx;
     condition_variable cv;
-    
-    vector<shared_ptr<ProcessStub>> core_process;
+    atomic<int> parked{0};
+
+    // Serializes swap decisions (make_room / swap_in); taken before the
+    // run queue locks
+    mutex swap_mtx;
+
+    // Virtual time (config.virtual_time): cores 0..num_cpu-1, the batch
+    // thread (participant num_cpu) and the timer thread (num_cpu + 1) wait
+    // on this clock instead of sleeping
+    SimClock clock;
+
+    // Processes in SLEEP, off their cores until their tick comes up. Ticks
+    // are milliseconds since construction, or virtual clock ticks.
+    TimerWheel<shared_ptr<ProcessStub>> sleepers;
+    mutex timer_mtx;
+    condition_variable timer_cv;
+    const chrono::steady_clock::time_point epoch = chrono::steady_clock::now();
 
 public:
     Scheduler(const Config &cfg)
         : config(cfg),
-          core_process(cfg.num_cpu, nullptr) {}
+          policy(make_scheduling_policy(cfg)),
+          runq(cfg.num_cpu),
+          admission(cfg.ws_window, cfg.pff_target, mem_manager ? mem_manager->frame_count() : 0) {}
 
     void add_process(shared_ptr<ProcessStub> p) {
         if (!p) return;
-        // If process has explicit code lines, treat that size as total_instructions
+        // If process has explicit code lines, compile them (again only if
+        // lines were added since) and count the instructions they will run
         {
             lock_guard<mutex> plk(p->mtx);
+            if (!p->program || p->program->code.size() != p->code.lines.size())
+                p->program = compile_program(p->code.lines, p->symbols);
             if (p->code.lines.size() > 0)
-                p->total_instructions = static_cast<int>(p->code.lines.size());
+                p->total_instructions = p->program->executed_total;
         }
 
-        lock_guard<mutex> lk(mtx);
-        ready_queue.push(p);
-        cv.notify_one();
+        if (!p->arrived.exchange(true)) p->arrival_time.store(timer_now());
+        enqueue(p);
+        wake_core();
     }
 
     void start() {
         if (running.load()) return;
         running.store(true);
+        if (config.virtual_time) clock.reset(config.num_cpu + 2);
+        {
+            lock_guard<mutex> lk(timer_mtx);
+            sleepers.reset(timer_now());
+        }
         cout << "Scheduler started (" << config.scheduler
-             << ") with " << config.num_cpu << " cores." << endl;
+             << ") with " << config.num_cpu << " cores"
+             << (config.virtual_time ? " on virtual time." : ".") << endl;
         
         // Start core threads
         for (int i = 0; i < config.num_cpu; ++i)
@@ -72,34 +137,256 @@ public:
         
         // Start batch process creation thread
         batch_thread = thread(&Scheduler::batch_process_loop, this);
+        timer_thread = thread(&Scheduler::timer_loop, this);
     }
 
     void stop() {
         running.store(false);
         cv.notify_all();
+        {
+            lock_guard<mutex> lk(timer_mtx);
+            timer_cv.notify_all();
+        }
+        clock.stop();
         
         if (batch_thread.joinable()) batch_thread.join();
+        if (timer_thread.joinable()) timer_thread.join();
         
         for (auto &t : core_threads)
             if (t.joinable()) t.join();
         core_threads.clear();
+
+        // Sleepers wake early rather than stay parked on a stopped clock
+        vector<shared_ptr<ProcessStub>> woken;
+        {
+            lock_guard<mutex> lk(timer_mtx);
+            sleepers.drain(woken);
+        }
+        for (auto &p : woken) {
+            add_log(p, "SLEEP end");
+            enqueue(p);
+        }
+        // and deferred processes go back to the run queues
+        {
+            lock_guard<mutex> lk(defer_mtx);
+            for (auto &d : deferred) runq.push_back_to(d.first, d.second, policy->priority(*d.second));
+            deferred.clear();
+            num_deferred.store(0);
+        }
         
         cout << "Scheduler stopped." << endl;
     }
 
     bool is_running() const { return running.load(); }
 
-    vector<shared_ptr<ProcessStub>> get_core_processes() const {
-        lock_guard<mutex> lk(mtx);
-        return core_process;
+    // Free up at least `bytes` of process memory by swapping out whole
+    // processes that are not on a core or attached to a screen (largest
+    // first). keep is never swapped. Returns true if free_memory now covers bytes.
+    bool make_room(uint64_t bytes, const shared_ptr<ProcessStub>& keep = nullptr) {
+        lock_guard<mutex> slk(swap_mtx);
+        return make_room_locked(bytes, keep);
+    }
+
+    // Bring a swapped-out process back, swapping others out if needed.
+    // Returns false if there is not enough memory for it yet.
+    bool swap_in(const shared_ptr<ProcessStub>& p) {
+        if (!p || !mem_manager) return false;
+        lock_guard<mutex> slk(swap_mtx);
+        if (!p->swapped_out.load()) return true;
+        if (!make_room_locked(p->memory_required, p)) return false;
+        used_memory += p->memory_required;
+        free_memory -= p->memory_required;
+        mem_manager->swap_in_process(p);
+        return true;
+    }
+
+    vector<shared_ptr<ProcessStub>> get_core_processes() {
+        return runq.current();
+    }
+
+    AdmissionControl::Stats admission_stats() const {
+        return admission.stats();
     }
 
 private:
+    bool make_room_locked(uint64_t bytes, const shared_ptr<ProcessStub>& keep) {
+        if (free_memory.load() >= bytes) return true;
+        if (!mem_manager) return false;
+
+        // Holding the run queues keeps the candidates from being dispatched
+        // meanwhile
+        auto locks = runq.lock_all();
+        vector<shared_ptr<ProcessStub>> victims;
+        {
+            lock_guard<mutex> rlk(repository_mutex);
+            for (auto &kv : processes) {
+                auto &q = kv.second;
+                if (q == keep || q->memory_required == 0 || q->finished.load() || q->attached.load() ||
+                    q->swapped_out.load() || q->assigned_core.load() != -1) continue;
+                bool on_core = false;
+                for (int c = 0; c < runq.cores() && !on_core; ++c) on_core = runq.current_locked(c) == q;
+                if (!on_core) victims.push_back(q);
+            }
+        }
+        sort(victims.begin(), victims.end(), [](const shared_ptr<ProcessStub> &a, const shared_ptr<ProcessStub> &b) {
+            return a->memory_required > b->memory_required;
+        });
+        for (auto &q : victims) {
+            if (free_memory.load() >= bytes) break;
+            mem_manager->swap_out_process(q);
+            used_memory -= q->memory_required;
+            free_memory += q->memory_required;
+        }
+        return free_memory.load() >= bytes;
+    }
+
+    // Queue p at its policy priority, on core's own queue or, for core -1,
+    // the injection queue; its waiting time runs from now
+    void enqueue(const shared_ptr<ProcessStub>& p, int core = -1) {
+        p->queued_at = timer_now();
+        uint64_t prio = policy->priority(*p);
+        if (core < 0) runq.inject(p, prio);
+        else runq.push_local(core, p, prio);
+    }
+
+    // A process was queued: let an idle core know
+    void wake_core() {
+        if (config.virtual_time) {
+            clock.notify_work();
+        } else if (parked.load() > 0) {
+            lock_guard<mutex> lk(mtx);
+            cv.notify_one();
+        }
+    }
+
+    // Next process for core that admission control lets run, looking at
+    // up to ADMIT_SCAN candidates. The ones it turns away leave the run
+    // queues until readmit() finds room for them.
+    shared_ptr<ProcessStub> pop_admitted(int core_id) {
+        int from;
+        shared_ptr<ProcessStub> p = runq.pop(core_id, &from);
+        for (size_t scanned = 1; p && !admission.admit(*p); ++scanned) {
+            p->assigned_core.store(-1);
+            {
+                lock_guard<mutex> lk(defer_mtx);
+                deferred.emplace_back(from, p);
+                num_deferred.store(deferred.size());
+            }
+            p = scanned < ADMIT_SCAN ? runq.pop(core_id, &from) : nullptr;
+        }
+        return p;
+    }
+
+    // Deferred processes that fit now go back to the queue they came from,
+    // still waiting since they were first queued: the one holding the
+    // reservation first, then the oldest
+    void readmit() {
+        if (num_deferred.load() == 0) return;
+        vector<pair<int, shared_ptr<ProcessStub>>> back;
+        {
+            lock_guard<mutex> lk(defer_mtx);
+            int reserver = admission.reserver();
+            for (auto it = deferred.begin(); reserver >= 0 && it != deferred.end(); ++it) {
+                if (it->second->id != reserver) continue;
+                if (admission.admit(*it->second)) {
+                    back.push_back(move(*it));
+                    deferred.erase(it);
+                }
+                break;
+            }
+            while (!deferred.empty() && admission.admit(*deferred.front().second)) {
+                back.push_back(move(deferred.front()));
+                deferred.pop_front();
+            }
+            num_deferred.store(deferred.size());
+        }
+        for (auto &d : back) {
+            runq.push_back_to(d.first, d.second, policy->priority(*d.second));
+            wake_core();
+        }
+    }
+
+    // Time the working set window spans: ws-window quanta, in SLEEP units
+    uint64_t ws_window_time() const {
+        uint64_t per_instruction = config.virtual_time ? 1 : max<uint32_t>(config.delay_per_exec, 1);
+        return (uint64_t)config.ws_window * config.quantum_cycles * per_instruction;
+    }
+
+    uint64_t timer_now() const {
+        if (config.virtual_time) return clock.now();
+        return (uint64_t)chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - epoch).count();
+    }
+
+    // Take a process that asked to SLEEP off its core; timer_loop queues it
+    // again when the sleep is over
+    void park_sleeper(const shared_ptr<ProcessStub>& p) {
+        uint64_t ticks = (uint64_t)p->sleep_request;
+        p->sleep_request = 0;
+        p->assigned_core.store(-1);
+        lock_guard<mutex> lk(timer_mtx);
+        sleepers.add(p, timer_now() + ticks);
+        if (config.virtual_time) clock.wake(config.num_cpu + 1);
+        else timer_cv.notify_one();
+    }
+
+    void timer_loop() {
+        const int id = config.num_cpu + 1;
+        vector<shared_ptr<ProcessStub>> due;
+        while (running.load()) {
+            uint64_t seen = config.virtual_time ? clock.work_seen() : 0;
+            uint64_t next;
+            {
+                unique_lock<mutex> lk(timer_mtx);
+                sleepers.advance(timer_now(), due);
+                next = sleepers.next_expiry();
+                if (!config.virtual_time && due.empty()) {
+                    // woken early by park_sleeper or stop
+                    auto until = next == UINT64_MAX ? chrono::steady_clock::now() + chrono::milliseconds(100)
+                                                    : epoch + chrono::milliseconds(next);
+                    timer_cv.wait_until(lk, until);
+                    continue;
+                }
+            }
+            for (auto &p : due) {
+                add_log(p, "SLEEP end");
+                enqueue(p);
+                wake_core();
+            }
+            if (!due.empty()) {
+                due.clear();
+                continue;
+            }
+            // virtual time: nothing due yet
+            if (next == UINT64_MAX) {
+                if (clock.wait_for_work(id, seen) < 0) break;
+            } else if (!clock.sleep_until(id, next)) {
+                break;
+            }
+        }
+    }
+
+    // Keep a core busy for n time units: milliseconds of wall-clock time,
+    // or n ticks of the virtual clock (counted as active CPU ticks)
+    void spend(int core_id, uint64_t n) {
+        if (!config.virtual_time) {
+            this_thread::sleep_for(chrono::milliseconds(n));
+            return;
+        }
+        if (!clock.sleep_for(core_id, n)) return;
+        active_ticks += n;
+        total_ticks += n;
+    }
+
     // Periodic batch process creation
     void batch_process_loop() {
         while (running.load()) {
-            int wait_ms = config.batch_process_freq * 1000;  // Convert to milliseconds
-            this_thread::sleep_for(chrono::milliseconds(wait_ms));
+            if (config.virtual_time) {
+                // every batch-process-freq ticks
+                if (!clock.sleep_for(config.num_cpu, config.batch_process_freq)) break;
+            } else {
+                int wait_ms = config.batch_process_freq * 1000;  // Convert to milliseconds
+                this_thread::sleep_for(chrono::milliseconds(wait_ms));
+            }
             
             if (!running.load()) break;
             
@@ -113,271 +400,321 @@ private:
         }
     }
 
-    // Helper to parse numeric or variable operand inside a process
-    static uint16_t resolve_operand(const shared_ptr<ProcessStub>& p, const string &tok) {
-        if (tok.empty()) return 0;
-        // try integer
-        try {
-            int v = stoi(tok);
-            if (v < 0) return 0;
-            if (v > 65535) return 65535;
-            return static_cast<uint16_t>(v);
-        } catch (...) {
-            lock_guard<mutex> lk(p->mtx);
-            auto it = p->vars.find(tok);
-            if (it == p->vars.end()) {
-                p->vars[tok] = 0;
-                return 0;
-            }
-            return it->second;
-        }
+    // Value of operand i: an immediate, or a variable (0 until assigned)
+    static uint16_t operand_value(const shared_ptr<ProcessStub>& p, const Program &prog, const Instr &ins, int i) {
+        if (!ins.is_var(i)) return static_cast<uint16_t>(ins.arg[i]);
+        return load_symbol(p, prog.var_slots[ins.arg[i]]);
     }
 
-    // Execute a single instruction for process p (hybrid model: only some ops)
-    void execute_instruction(const shared_ptr<ProcessStub>& p, const string &instr, int core_id) {
+    // Execute a single compiled instruction for process p (hybrid model: only some ops)
+    void execute_instruction(const shared_ptr<ProcessStub>& p, const Program &prog, const Instr &ins, int core_id) {
         if (!p) return;
-        // trim
-        size_t s = instr.find_first_not_of(" \t\r\n");
-        if (s == string::npos) return;
-        string line = instr.substr(s);
-
-        // simple tokenization
-        istringstream iss(line);
-        string op;
-        iss >> op;
-        if (op == "SLEEP") {
-            string tstr; iss >> tstr;
-            int t = 50;
-            try { t = stoi(tstr); } catch(...) {}
-            add_log(p, "SLEEP start for " + to_string(t) + " ms", core_id);
-            this_thread::sleep_for(chrono::milliseconds(t));
-            add_log(p, "SLEEP end", core_id);
-        } else if (op == "PRINT") {
-            // rest of line is message (may be quoted)
-            string rest;
-            getline(iss, rest);
-            if (!rest.empty()) {
-                // trim leading spaces
-                size_t ppos = rest.find_first_not_of(" \t\r\n\"");
-                if (ppos != string::npos) rest = rest.substr(ppos);
-                // trim trailing quotes/spaces
-                size_t epos = rest.find_last_not_of(" \t\r\n\"");
-                if (epos != string::npos) rest = rest.substr(0, epos+1);
+        const string *text = prog.strings.empty() ? nullptr : &prog.strings[ins.text];
+        switch (ins.op) {
+        case Opcode::NOP:
+            break;
+        case Opcode::SKIP:
+            add_log(p, string("Skipped instruction (not executed by scheduler): ") + *text, core_id);
+            break;
+        case Opcode::BAD:
+            add_log(p, *text, core_id);
+            break;
+        case Opcode::DECLARE: {
+            const string &name = prog.var_names[ins.arg[0]];
+            int slot = prog.var_slots[ins.arg[0]];
+            if (slot < 0) {
+                add_log(p, "Symbol table full (32 variables). DECLARE " + name + " ignored", core_id);
+                break;
             }
-            add_log(p, string("PRINT: ") + rest, core_id);
-        } else if (op == "ADD" || op == "SUB") {
-            string target, a, b;
-            iss >> target >> a >> b;
-            if (target.empty() || a.empty() || b.empty()) {
-                add_log(p, string("Malformed ") + op + " instruction", core_id);
-                return;
-            }
-            uint16_t va = resolve_operand(p, a);
-            uint16_t vb = resolve_operand(p, b);
+            uint16_t v = operand_value(p, prog, ins, 1);
+            store_symbol(p, slot, v);
+            add_log(p, "DECLARE: " + name + " = " + to_string(v), core_id);
+            break;
+        }
+        case Opcode::SLEEP: {
+            int t = static_cast<int>(ins.arg[0]);
+            add_log(p, "SLEEP start for " + to_string(t) + (config.virtual_time ? " ticks" : " ms"), core_id);
+            // the core loop parks the process and moves on to other work
+            if (t > 0) p->sleep_request = t;
+            else add_log(p, "SLEEP end", core_id);
+            break;
+        }
+        case Opcode::PRINT:
+            add_log(p, string("PRINT: ") + *text, core_id);
+            break;
+        case Opcode::ADD:
+        case Opcode::SUB: {
+            uint16_t va = operand_value(p, prog, ins, 1);
+            uint16_t vb = operand_value(p, prog, ins, 2);
             uint16_t res = 0;
-            if (op == "ADD") {
+            if (ins.op == Opcode::ADD) {
                 int sum = (int)va + (int)vb;
                 if (sum > 65535) sum = 65535;
                 res = static_cast<uint16_t>(sum);
             } else {
                 res = (va > vb) ? static_cast<uint16_t>(va - vb) : 0;
             }
-            {
-                lock_guard<mutex> lk(p->mtx);
-                p->vars[target] = res;
-            }
-            add_log(p, op + string(": ") + target + " = " + to_string(res), core_id);
-        } else if (op == "FOR") {
-            // FOR n - expand into n no-op iterations quickly (we treat FOR as 1 instruction for simplicity)
-            string nstr; iss >> nstr;
-            int n = 1;
-            try { n = stoi(nstr); } catch(...) {}
-            // We'll log and sleep briefly to simulate loop overhead
-            add_log(p, "FOR start x" + to_string(n), core_id);
-            this_thread::sleep_for(chrono::milliseconds(10 * min(5, n)));
-            add_log(p, "FOR end", core_id);
-        } else if (op == "READ") {
-            string var, addrstr;
-            iss >> var >> addrstr;
-            if (var.empty() || addrstr.empty()) {
-                add_log(p, "Malformed READ instruction", core_id);
-                return;
-            }
-            uint32_t addr = 0;
-            try { addr = stoul(addrstr, nullptr, 0); } catch(...) {
-                add_log(p, "Invalid READ address: " + addrstr, core_id);
-                return;
-            }
+            const string &target = prog.var_names[ins.arg[0]];
+            store_symbol(p, prog.var_slots[ins.arg[0]], res);
+            add_log(p, string(ins.op == Opcode::ADD ? "ADD" : "SUB") + ": " + target + " = " + to_string(res), core_id);
+            break;
+        }
+        case Opcode::FOR:
+        case Opcode::END:
+            break;   // control flow, handled by step()
+        case Opcode::READ: {
             if (!mem_manager) {
                 add_log(p, "Memory manager not available", core_id);
-                return;
+                break;
             }
             uint16_t val = 0;
-            if (!mem_manager->read_u16(p, addr, val)) {
-                add_log(p, string("Memory access violation at ") + addrstr, core_id);
+            if (!mem_manager->read_u16(p, ins.arg[1], val)) {
+                add_log(p, string("Memory access violation at ") + *text, core_id);
                 p->finished.store(true);
-                return;
+                break;
             }
-            {
-                lock_guard<mutex> lk(p->mtx);
-                if (p->vars.size() < 32) {
-                    p->vars[var] = val;
-                }
+            const string &var = prog.var_names[ins.arg[0]];
+            store_symbol(p, prog.var_slots[ins.arg[0]], val);
+            add_log(p, string("READ: ") + var + " <- " + to_string(val) + " from " + *text, core_id);
+            break;
+        }
+        case Opcode::WRITE: {
+            if (!mem_manager) {
+                add_log(p, "Memory manager not available", core_id);
+                break;
             }
-            add_log(p, string("READ: ") + var + " <- " + to_string(val) + " from " + addrstr, core_id);
-        } else if (op == "WRITE") {
-            string addrstr, valstr;
-            iss >> addrstr >> valstr;
-            if (addrstr.empty() || valstr.empty()) {
-                add_log(p, "Malformed WRITE instruction", core_id);
-                return;
+            uint16_t uv = static_cast<uint16_t>(ins.arg[1]);
+            if (!mem_manager->write_u16(p, ins.arg[0], uv)) {
+                add_log(p, string("Memory access violation at ") + *text, core_id);
+                p->finished.store(true);
+                break;
             }
-            uint32_t addr = 0;
-            try { addr = stoul(addrstr, nullptr, 0); } catch(...) {
-                add_log(p, "Invalid WRITE address: " + addrstr, core_id);
-                return;
+            add_log(p, string("WRITE: ") + *text + " <- " + to_string(uv), core_id);
+            break;
+        }
+        case Opcode::COPY: {
+            if (!mem_manager) {
+                add_log(p, "Memory manager not available", core_id);
+                break;
             }
-            int v = 0;
-            try { v = stoi(valstr); } catch(...) {
-                add_log(p, "Invalid WRITE value: " + valstr, core_id);
-                return;
+            const string &dststr = *text, &srcstr = prog.strings[ins.text + 1];
+            uint32_t len = ins.arg[2];
+            // check the range before sizing the buffer by it
+            bool in_range = (uint64_t)max(ins.arg[0], ins.arg[1]) + len <= p->memory_required;
+            vector<uint8_t> buf(in_range ? len : 0);
+            if (!in_range || !mem_manager->read_bytes(p, ins.arg[1], buf.data(), len) ||
+                !mem_manager->write_bytes(p, ins.arg[0], buf.data(), len)) {
+                add_log(p, string("Memory access violation at ") + srcstr + "/" + dststr, core_id);
+                p->finished.store(true);
+                break;
             }
-            uint16_t uv = static_cast<uint16_t>(max(0, min(65535, v)));
+            add_log(p, string("COPY: ") + dststr + " <- " + srcstr + " (" + to_string(len) + " bytes)", core_id);
+            break;
+        }
+        case Opcode::FILL: {
             if (!mem_manager) {
                 add_log(p, "Memory manager not available", core_id);
-                return;
+                break;
             }
-            if (!mem_manager->write_u16(p, addr, uv)) {
-                add_log(p, string("Memory access violation at ") + addrstr, core_id);
+            uint8_t bv = static_cast<uint8_t>(ins.arg[1]);
+            uint32_t len = ins.arg[2];
+            if (!mem_manager->fill(p, ins.arg[0], bv, len)) {
+                add_log(p, string("Memory access violation at ") + *text, core_id);
                 p->finished.store(true);
-                return;
+                break;
             }
-            add_log(p, string("WRITE: ") + addrstr + " <- " + to_string(uv), core_id);
-        } else {
-            add_log(p, string("Skipped instruction (not executed by scheduler): ") + op, core_id);
+            add_log(p, string("FILL: ") + *text + " <- " + to_string(bv) + " x" + to_string(len), core_id);
+            break;
+        }
         }
     }
 
+    static bool program_done(const shared_ptr<ProcessStub>& p, const shared_ptr<const Program>& prog) {
+        return !prog || p->pc >= (int)prog->code.size();
+    }
+
+    // Run the instruction at p->pc and advance it, following FOR loops.
+    // Returns false for END, which only loops back and is not counted as
+    // an executed instruction.
+    bool step(const shared_ptr<ProcessStub>& p, const Program &prog, int core_id) {
+        const Instr &ins = prog.code[p->pc];
+        if (ins.op == Opcode::FOR) {
+            int n = static_cast<int>(ins.arg[0]);
+            int end = static_cast<int>(ins.arg[1]);
+            add_log(p, "FOR start x" + to_string(n), core_id);
+            if (n <= 0 || end == p->pc || p->loop_depth >= FOR_MAX_DEPTH) {
+                // nothing to repeat: skip past the body
+                add_log(p, "FOR end", core_id);
+                p->pc = end + 1;
+            } else {
+                p->loops[p->loop_depth++] = {p->pc + 1, n};
+                p->pc++;
+            }
+            return true;
+        }
+        if (ins.op == Opcode::END) {
+            if (p->loop_depth == 0) {   // its FOR was compiled without a body
+                p->pc++;
+                return false;
+            }
+            ProcessStub::LoopFrame &top = p->loops[p->loop_depth - 1];
+            if (--top.remaining > 0) {
+                p->pc = top.body;
+            } else {
+                p->loop_depth--;
+                add_log(p, "FOR end", core_id);
+                p->pc++;
+            }
+            return false;
+        }
+        execute_instruction(p, prog, ins, core_id);
+        p->pc++;
+        return true;
+    }
+
     void core_loop(int core_id) {
         while (running.load()) {
-            // Each pass is one tick
-            total_ticks++;
-
             shared_ptr<ProcessStub> p;
 
-            {
-                unique_lock<mutex> lk(mtx);
-                // Wait small amount for new work (tick granularity)
-                cv.wait_for(lk, chrono::milliseconds(100), [&]() { return !ready_queue.empty() || !running.load(); });
-
-                if (!running.load()) break;
+            // periodic policy work (MLFQ priority boost)
+            if (policy->period() && policy->due(timer_now()))
+                runq.refile([this](ProcessStub &q) { policy->refile(q); return policy->priority(q); });
+
+            if (config.virtual_time) {
+                // Idle until work shows up; the clock runs on meanwhile and
+                // every tick that passes is an idle tick for this core
+                uint64_t seen = clock.work_seen();
+                p = pop_admitted(core_id);
+                if (!p) {
+                    // nothing runnable: deferred processes may fit now
+                    readmit();
+                    p = pop_admitted(core_id);
+                }
+                if (!p) {
+                    int64_t idle = clock.wait_for_work(core_id, seen);
+                    if (idle < 0) break;
+                    idle_ticks += idle;
+                    total_ticks += idle;
+                    continue;
+                }
+            } else {
+                // Each pass is one tick
+                total_ticks++;
+
+                p = pop_admitted(core_id);
+                if (!p) {
+                    // nothing runnable: deferred processes may fit now
+                    readmit();
+                    p = pop_admitted(core_id);
+                }
+                if (!p) {
+                    // Wait small amount for new work (tick granularity)
+                    {
+                        unique_lock<mutex> lk(mtx);
+                        parked++;
+                        cv.wait_for(lk, chrono::milliseconds(100), [&]() { return runq.size() > 0 || !running.load(); });
+                        parked--;
+                    }
+                    if (!running.load()) break;
+                    p = pop_admitted(core_id);
+                }
 
-                if (ready_queue.empty()) {
+                if (!p) {
                     // no work this tick
                     idle_ticks++;
                     continue;
                 }
 
-                // there is work: take next
+                // there is work
                 active_ticks++;
-                p = ready_queue.front();
-                ready_queue.pop();
-                core_process[core_id] = p;
-                active_cores.fetch_add(1);
             }
+            runq.set_current(core_id, p);
+            active_cores.fetch_add(1);
+            p->wait_time += timer_now() - p->queued_at;
 
-            if (!p) {
-                // nothing to do
-                {
-                    lock_guard<mutex> lk(mtx);
-                    core_process[core_id] = nullptr;
-                    active_cores.fetch_sub(1);
+            if (p->swapped_out.load() && !swap_in(p)) {
+                // no room to bring it back yet: leave it queued
+                runq.set_current(core_id, nullptr);
+                active_cores.fetch_sub(1);
+                admission.release(*p);
+                enqueue(p, core_id);
+                readmit();
+                // let time pass so running processes can finish and free memory
+                if (config.virtual_time && clock.sleep_for(core_id, 1)) {
+                    idle_ticks++;
+                    total_ticks++;
                 }
                 continue;
             }
 
-            p->assigned_core.store(core_id);
             add_log(p, "Core " + to_string(core_id) + ": Picked process " + p->name, core_id);
 
-            // Hybrid model: scheduler executes a limited set of instructions
-            if (config.scheduler == "fcfs") {
-                // FCFS: run until completion
-                while (running.load() && p->current_instruction.load() < p->total_instructions) {
-                    int idx = p->current_instruction.load();
-                    string instr;
-                    {
-                        lock_guard<mutex> lk(p->mtx);
-                        if (idx < (int)p->code.lines.size()) instr = p->code.lines[idx];
-                    }
-                    // execute the instruction (only allowed subset will be executed)
-                    execute_instruction(p, instr, core_id);
-
-                    // instruction execution takes a base time (simulate)
-                    int delay = (config.delay_per_exec > 0) ? config.delay_per_exec : 1;
-                    this_thread::sleep_for(chrono::milliseconds(delay));
-
-                    p->current_instruction.fetch_add(1);
-                }
-
-                // If FCFS finished
-                if (p->current_instruction.load() >= p->total_instructions) {
-                    p->finished.store(true);
-                    p->assigned_core.store(-1);
-                    add_log(p, "Core " + to_string(core_id) + ": FCFS job finished", core_id);
-
-                    // Free process memory if allocated
-                    if (mem_manager && p->memory_required > 0) {
-                        mem_manager->free_process(p);
-                        used_memory -= p->memory_required;
-                        free_memory += p->memory_required;
-                    }
-                }
-            } else if (config.scheduler == "rr") {
-                // Round Robin: execute for quantum instructions
-                int quantum = config.quantum_cycles;
-                for (int q = 0; q < quantum && running.load(); ++q) {
-                    if (p->current_instruction.load() >= p->total_instructions) break;
-
-                    int idx = p->current_instruction.load();
-                    string instr;
-                    {
-                        lock_guard<mutex> lk(p->mtx);
-                        if (idx < (int)p->code.lines.size()) instr = p->code.lines[idx];
-                    }
-
-                    execute_instruction(p, instr, core_id);
-
-                    int delay = (config.delay_per_exec > 0) ? config.delay_per_exec : 1;
-                    this_thread::sleep_for(chrono::milliseconds(delay));
-
-                    p->current_instruction.fetch_add(1);
-                }
+            // the compiled program, held for this whole turn on the core
+            shared_ptr<const Program> prog;
+            {
+                lock_guard<mutex> lk(p->mtx);
+                prog = p->program;
+            }
 
-                if (p->current_instruction.load() >= p->total_instructions) {
-                    p->finished.store(true);
-                    p->assigned_core.store(-1);
-                    add_log(p, "Core " + to_string(core_id) + ": RR job finished", core_id);
+            // Hybrid model: scheduler executes a limited set of instructions.
+            // The policy sets the length of the turn (0: until the process
+            // finishes); slices count instructions, or ticks on virtual time
+            // where each instruction takes delay ticks.
+            uint32_t slice = policy->time_slice(*p);
+            uint32_t used = 0;
+            uint64_t executed = 0;
+            uint64_t faults = p->page_faults.load();
+            while (running.load() && !program_done(p, prog) && (slice == 0 || used < slice)) {
+                // execute the instruction (only allowed subset will be executed)
+                if (!step(p, *prog, core_id)) continue;
+                executed++;
+
+                // instruction execution takes a base time (simulate)
+                int delay = (config.delay_per_exec > 0) ? config.delay_per_exec : 1;
+                spend(core_id, delay);
+
+                p->current_instruction.fetch_add(1);
+                used += config.virtual_time ? delay : 1;
+                if (p->sleep_request > 0) break;   // gives up the rest of the turn
+            }
 
-                    // Free process memory if allocated
-                    if (mem_manager && p->memory_required > 0) {
-                        mem_manager->free_process(p);
-                        used_memory -= p->memory_required;
-                        free_memory += p->memory_required;
-                    }
-                } else {
-                    // requeue
-                    p->assigned_core.store(-1);
-                    lock_guard<mutex> lk(mtx);
-                    ready_queue.push(p);
-                    cv.notify_one();
+            admission.end_turn(*p, p->page_faults.load() - faults, executed);
+
+            // Parked for SLEEP, finished, or preempted. Finished processes
+            // give up their working set charge, and so do ones sleeping for
+            // longer than the working set window (shorter naps keep their
+            // pages from being taken meanwhile); a process that has had its
+            // turns makes room for a deferred one.
+            if (p->sleep_request > 0) {
+                policy->on_requeue(*p, used);
+                bool leave = (uint64_t)p->sleep_request > ws_window_time() || admission.should_yield(*p);
+                if (leave) admission.release(*p);
+                park_sleeper(p);
+            } else if (program_done(p, prog)) {
+                p->finish_time.store(timer_now());
+                p->finished.store(true);
+                p->assigned_core.store(-1);
+                add_log(p, "Core " + to_string(core_id) + ": " + policy->name() + " job finished", core_id);
+
+                // Free process memory if allocated
+                if (mem_manager && p->memory_required > 0) {
+                    mem_manager->free_process(p);
+                    used_memory -= p->memory_required;
+                    free_memory += p->memory_required;
                 }
+                admission.release(*p);
+            } else {
+                // requeue at the back of this core's queue; idle cores
+                // may steal it from there
+                policy->on_requeue(*p, used);
+                if (admission.should_yield(*p)) admission.release(*p);
+                enqueue(p, core_id);
+                wake_core();
             }
+            readmit();
 
-            {
-                lock_guard<mutex> lk(mtx);
-                core_process[core_id] = nullptr;
-                active_cores.fetch_sub(1);
-            }
+            runq.set_current(core_id, nullptr);
+            active_cores.fetch_sub(1);
         }
     }
 };
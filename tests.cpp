@@ -0,0 +1,30 @@
+// Runs the unit tests of every *_test.cpp linked in, or only those whose
+// file or test name contains one of the arguments.
+// Build:
+//   g++ -std=c++17 -O2 -pthread -o tests tests.cpp replacement_test.cpp pagecodec_test.cpp timerwheel_test.cpp bytecode_test.cpp admission_test.cpp memory_test.cpp runqueue_test.cpp MemoryManager.cpp
+#include <cstring>
+#include <iostream>
+#include "TestHarness.h"
+using namespace std;
+
+static bool selected(const TestCase &t, int argc, char **argv) {
+    if (argc < 2) return true;
+    for (int i = 1; i < argc; ++i)
+        if (strstr(t.file, argv[i]) || strstr(t.name, argv[i])) return true;
+    return false;
+}
+
+int main(int argc, char **argv) {
+    int run = 0, failed = 0;
+    for (const TestCase &t : test_cases()) {
+        if (!selected(t, argc, argv)) continue;
+        int before = test_failures;
+        t.run();
+        ++run;
+        bool ok = test_failures == before;
+        if (!ok) ++failed;
+        cout << (ok ? "OK     " : "FAILED ") << t.file << ": " << t.name << "\n";
+    }
+    cout << run - failed << "/" << run << " tests passed\n";
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,119 @@
+// TimerWheel against a plain sorted list of timers, with expiries on both
+// sides of each level boundary (64, 4096, 262144 and 2^24 ticks ahead; past
+// 2^24 a timer waits in the last level and is refiled).
+#include <algorithm>
+#include <map>
+#include <random>
+#include <vector>
+#include "TimerWheel.h"
+#include "TestHarness.h"
+using namespace std;
+
+struct Reference {
+    multimap<uint64_t, int> timers;   // expiry -> id
+
+    // ids due by now, sorted
+    vector<int> advance(uint64_t now) {
+        vector<int> due;
+        auto end = timers.upper_bound(now);
+        for (auto it = timers.begin(); it != end; ++it) due.push_back(it->second);
+        timers.erase(timers.begin(), end);
+        sort(due.begin(), due.end());
+        return due;
+    }
+};
+
+static vector<uint64_t> boundary_offsets() {
+    vector<uint64_t> v;
+    for (uint64_t edge : {1ull, 64ull, 4096ull, 262144ull, 1ull << 24})
+        for (int64_t d = -2; d <= 2; ++d)
+            if ((int64_t)edge + d > 0) v.push_back(edge + d);
+    return v;
+}
+
+// One timer per offset from start; advance in steps of `step`, checking
+// each batch against the reference
+static void run(uint64_t start, uint64_t step) {
+    TimerWheel<int> w;
+    Reference ref;
+    w.reset(start);
+    int id = 0;
+    for (uint64_t off : boundary_offsets()) {
+        w.add(id, start + off);
+        ref.timers.emplace(start + off, id++);
+    }
+    CHECK(w.size() == ref.timers.size());
+
+    uint64_t now = start;
+    while (!ref.timers.empty()) {
+        uint64_t first = ref.timers.begin()->first;
+        uint64_t next = w.next_expiry();
+        CHECK(next > now && next <= first);   // never past the earliest timer
+        now += step;
+        vector<int> fired;
+        w.advance(now, fired);
+        sort(fired.begin(), fired.end());
+        CHECK(fired == ref.advance(now));
+        CHECK(w.size() == ref.timers.size());
+    }
+    CHECK(w.next_expiry() == UINT64_MAX);
+}
+
+// Sleeping until next_expiry each time, as the scheduler does, reaches every
+// timer exactly on its tick
+static void run_by_next_expiry(uint64_t start) {
+    TimerWheel<int> w;
+    Reference ref;
+    w.reset(start);
+    int failures_before = test_failures;
+    mt19937_64 rng(start);
+    auto offs = boundary_offsets();
+    for (int id = 0; id < 300; ++id) {
+        uint64_t off = id < (int)offs.size() ? offs[id] : 1 + rng() % (1ull << 20);
+        w.add(id, start + off);
+        ref.timers.emplace(start + off, id);
+    }
+    while (w.size() > 0) {
+        uint64_t t = w.next_expiry();
+        CHECK(t <= ref.timers.begin()->first);
+        vector<int> fired;
+        w.advance(t, fired);
+        sort(fired.begin(), fired.end());
+        CHECK(fired == ref.advance(t));
+        if (test_failures != failures_before) return;
+    }
+    CHECK(ref.timers.empty());
+}
+
+TEST(due_and_empty_edges) {
+    TimerWheel<int> w;
+    w.reset(100);
+    vector<int> out;
+    w.add(1, 50);     // already due: next tick
+    w.add(2, 100);
+    CHECK(w.next_expiry() == 101);
+    w.advance(101, out);
+    CHECK(out.size() == 2);
+    out.clear();
+    w.add(3, 200);
+    w.add(4, 1u << 30);
+    w.drain(out);
+    CHECK(out.size() == 2 && w.size() == 0);
+    out.clear();
+    w.advance(5000, out);   // empty: jumps straight there
+    CHECK(out.empty() && w.now() == 5000);
+}
+
+TEST(fixed_steps_across_level_boundaries) {
+    run(0, 997);
+    run(0, 4093);
+    run(63, 4096);
+    run(4095, 777);
+    run(262143, 1ull << 16);
+    run((1ull << 24) - 1, 100003);
+}
+
+TEST(next_expiry_steps_across_level_boundaries) {
+    for (uint64_t start : {0ull, 1ull, 4000ull, 262100ull, (1ull << 24) + 17})
+        run_by_next_expiry(start);
+}